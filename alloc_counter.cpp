@@ -0,0 +1,154 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: allocation counting for the zero-allocation frame loop check
+
+#include "alloc_counter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <opencv2/opencv.hpp>
+
+static std::atomic<uint64_t> ownCount{0};
+static std::atomic<uint64_t> libraryCount{0};
+static thread_local bool counting = false;
+static thread_local int libraryDepth = 0;
+
+
+static void countOne() {
+    if (!counting) {
+        return;
+    }
+    if (libraryDepth > 0) {
+        libraryCount.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        ownCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+// Counts cv::Mat buffers, which bypass operator new, and leaves the rest to OpenCV's own allocator
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+        if (!data) {
+            countOne();
+        }
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData *data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const override {
+        return cv::Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData *data) const override {
+        cv::Mat::getStdAllocator()->deallocate(data);
+    }
+};
+
+
+bool installAllocationCounter() {
+    static CountingMatAllocator allocator;
+    cv::Mat::setDefaultAllocator(&allocator);
+    return true;
+}
+
+
+void countAllocations() {
+    counting = true;
+}
+
+
+uint64_t ownAllocations() {
+    return ownCount.load();
+}
+
+
+uint64_t libraryAllocations() {
+    return libraryCount.load();
+}
+
+
+LibraryScope::LibraryScope() {
+    libraryDepth++;
+}
+
+
+LibraryScope::~LibraryScope() {
+    libraryDepth--;
+}
+
+
+OutputScope::OutputScope(const cv::Mat &output)
+    : output(output), data(output.data), rows(output.rows), cols(output.cols), type(output.type()) {}
+
+
+OutputScope::~OutputScope() {
+    // Mat::create only allocates when the buffer is empty or its size or type changes
+    bool reallocated = output.data != data || output.rows != rows || output.cols != cols || output.type() != type;
+    if (counting && reallocated) {
+        ownCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+void *operator new(size_t size) {
+    countOne();
+    void *p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    countOne();
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    std::free(p);
+}
+
+#else
+
+bool installAllocationCounter() {
+    return false;
+}
+
+
+void countAllocations() {}
+
+
+uint64_t ownAllocations() {
+    return 0;
+}
+
+
+uint64_t libraryAllocations() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,52 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: allocation counting for the zero-allocation frame loop check
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+// Built with -DCOUNT_ALLOCATIONS, global operator new and the default cv::Mat allocator
+// count every allocation made on the threads that called countAllocations(). Calls into
+// OpenCV algorithms, whose internal buffers are not ours to pool, run inside a LibraryScope
+// and are counted apart. Without the flag every function here does nothing and the
+// counters stay zero.
+
+// Swap in the counting cv::Mat allocator; false when built without COUNT_ALLOCATIONS
+bool installAllocationCounter();
+
+// Count allocations made by the calling thread from now on
+void countAllocations();
+
+// Totals over every counting thread
+uint64_t ownAllocations();
+uint64_t libraryAllocations();
+
+struct LibraryScope {
+#ifdef COUNT_ALLOCATIONS
+    LibraryScope();
+    ~LibraryScope();
+#else
+    LibraryScope() {}
+#endif
+};
+
+// An OpenCV call writing into one of our pooled Mats: the call's temporaries are counted as
+// the library's, but the output being (re)allocated counts as ours, so a frame, grey or
+// rectify buffer that stops being reused still fails the check
+struct OutputScope {
+#ifdef COUNT_ALLOCATIONS
+    explicit OutputScope(const cv::Mat &output);
+    ~OutputScope();
+
+    LibraryScope library;
+    const cv::Mat &output;
+    const uchar *data;
+    int rows, cols, type;
+#else
+    explicit OutputScope(const cv::Mat &) {}
+#endif
+};
+
+#endif
@@ -0,0 +1,248 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: board detection and pose for several cameras at once, headless, on one shared worker pool
+
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <opencv2/opencv.hpp>
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include "metrics.h"
+#include "stream_server.h"
+
+// Parse "6x9" into a board size
+static bool parseSize(const std::string &text, cv::Size &size) {
+    int w = 0, h = 0;
+    if (sscanf(text.c_str(), "%dx%d", &w, &h) != 2 || w < 2 || h < 2) {
+        return false;
+    }
+    size = cv::Size(w, h);
+    return true;
+}
+
+
+// Streams from a YAML/JSON file:
+//   streams:
+//     - { input: "rec/left.mp4", id: left, board: "6x9", square_size: 1.0, lod: 12 }
+//     - { input: "1", calibration: "calibration/lab_1280x720.yaml", lod: 0 }
+// Keys left out take the command line defaults.
+static bool loadStreamConfigs(const std::string &path, const StreamConfig &defaults, std::vector<StreamConfig> &configs) {
+    cv::FileStorage fs;
+    try {
+        if (!fs.open(path, cv::FileStorage::READ)) {
+            return false;
+        }
+    } catch (const cv::Exception &) {
+        return false;
+    }
+    cv::FileNode streams = fs["streams"];
+    for (size_t i = 0; i < streams.size(); ++i) {
+        cv::FileNode node = streams[(int)i];
+        StreamConfig config = defaults;
+        config.input = (std::string)node["input"];
+        if (config.input.empty()) {
+            std::cerr << "Error: Stream " << i << " in " << path << " has no input" << std::endl;
+            return false;
+        }
+        if (!node["id"].empty()) {
+            config.id = (std::string)node["id"];
+        }
+        if (!node["calibration"].empty()) {
+            config.calibrationFile = (std::string)node["calibration"];
+        }
+        if (!node["board"].empty() && !parseSize((std::string)node["board"], config.boardSize)) {
+            std::cerr << "Error: Bad board size for stream " << config.input << std::endl;
+            return false;
+        }
+        if (!node["square_size"].empty()) {
+            config.squareSize = (float)node["square_size"];
+        }
+        if (!node["lod"].empty()) {
+            config.lod = (int)node["lod"];
+        }
+        configs.push_back(config);
+    }
+    return true;
+}
+
+
+// One console command: "restart ID", "stop ID", "status", "quit"
+static void runCommand(StreamServer &server, std::atomic<bool> &quit, const std::string &line) {
+    std::istringstream words(line);
+    std::string command, id;
+    words >> command >> id;
+    if (command == "restart") {
+        printf(restartStream(server, id) ? "Restarting %s\n" : "No stream %s\n", id.c_str());
+    } else if (command == "stop") {
+        printf(stopStream(server, id) ? "Stopping %s\n" : "No stream %s\n", id.c_str());
+    } else if (command == "status") {
+        printStreamStatus(server, false);
+    } else if (command == "quit") {
+        quit = true;
+    } else if (!command.empty()) {
+        printf("Commands: restart ID, stop ID, status, quit\n");
+    }
+}
+
+
+#ifdef _WIN32
+// No poll on console handles: blocks in getline and is left to end with the process. Commands
+// that arrive once the server is stopping do nothing.
+static void consoleLoop(StreamServer &server, std::atomic<bool> &quit) {
+    std::string line;
+    while (!quit && std::getline(std::cin, line)) {
+        runCommand(server, quit, line);
+    }
+}
+#else
+// Commands on stdin, polled so the thread sees quit and main can join it before the server stops
+static void consoleLoop(StreamServer &server, std::atomic<bool> &quit) {
+    std::string pending;
+    char buffer[256];
+    while (!quit) {
+        struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+        int ready = poll(&input, 1, 100);
+        if (ready < 0 && errno != EINTR) {
+            return;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        ssize_t length = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return;   // end of input
+        }
+        pending.append(buffer, (size_t)length);
+        size_t end;
+        while (!quit && (end = pending.find('\n')) != std::string::npos) {
+            runCommand(server, quit, pending.substr(0, end));
+            pending.erase(0, end + 1);
+        }
+    }
+}
+#endif
+
+
+int main(int argc, char *argv[]) {
+    StreamServer server;
+    StreamConfig defaults;
+    std::vector<std::string> inputs;
+    std::string configFile;  // Streams with their own settings, in addition to the inputs on the command line
+    double duration = 0;  // Stop after this many seconds, 0 runs until every stream has ended
+    bool console = false;  // Read restart/stop commands from stdin
+    std::string metricsTarget;  // JSON-lines metrics destination: a file path or udp://host:port
+    double metricsInterval = 1.0;  // Seconds per exported metrics line
+    double statusInterval = 5.0;  // Seconds between per-stream status reports, 0 for none
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            configFile = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            server.workers = std::max(0, atoi(argv[++i]));  // Detection/pose threads shared by all streams, 0 uses every core
+        } else if (strcmp(argv[i], "--calib-dir") == 0 && i + 1 < argc) {
+            server.calibrationDir = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            server.outputDir = argv[++i];
+        } else if (strcmp(argv[i], "--save-frames") == 0) {
+            server.saveFrames = true;
+        } else if (strcmp(argv[i], "--loop") == 0) {
+            server.loop = true;
+        } else if (strcmp(argv[i], "--pace") == 0 && i + 1 < argc) {
+            server.paceFps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-frames") == 0 && i + 1 < argc) {
+            server.maxFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--detect") == 0 && i + 1 < argc) {
+            if (!parseDetectMode(argv[++i], server.detectMode)) {
+                printf("Unknown detection mode: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            if (!parseSize(argv[++i], defaults.boardSize)) {
+                printf("Bad board size: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--lod") == 0 && i + 1 < argc) {
+            defaults.lod = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--console") == 0) {
+            console = true;
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metricsTarget = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+            metricsInterval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--status-interval") == 0 && i + 1 < argc) {
+            statusInterval = atof(argv[++i]);
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (server.saveFrames && server.outputDir.empty()) {
+        std::cerr << "Error: --save-frames needs --output" << std::endl;
+        return -1;
+    }
+
+    std::vector<StreamConfig> configs;
+    if (!configFile.empty() && !loadStreamConfigs(configFile, defaults, configs)) {
+        std::cerr << "Error: Could not read streams from " << configFile << std::endl;
+        return -1;
+    }
+    for (const std::string &input : inputs) {
+        StreamConfig config = defaults;
+        config.input = input;
+        configs.push_back(config);
+    }
+    if (configs.empty()) {
+        printf("Usage: ar_server [options] <input>... [--config streams.yaml]\n");
+        return -1;
+    }
+    for (const StreamConfig &config : configs) {
+        addStream(server, config);
+    }
+
+    startLogger(statusInterval > 0 ? statusInterval : 1.0);
+    if (!metricsTarget.empty() && !startMetricsExport(metricsTarget, metricsInterval)) {
+        return -1;
+    }
+
+    startServer(server);
+    printf("Serving %d streams\n", (int)server.streams.size());
+
+    std::atomic<bool> quit{false};
+    std::thread consoleThread;
+    if (console) {
+        consoleThread = std::thread(consoleLoop, std::ref(server), std::ref(quit));
+    }
+    double startTime = pipelineClock();
+    logReady(LOG_STATUS);   // the first report after one interval
+    while (!quit && serverRunning(server) && (duration <= 0 || pipelineClock() - startTime < duration)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (statusInterval > 0 && logReady(LOG_STATUS)) {
+            printStreamStatus(server, true);
+        }
+    }
+    quit = true;
+#ifdef _WIN32
+    if (consoleThread.joinable()) {
+        consoleThread.detach();
+    }
+#else
+    if (consoleThread.joinable()) {
+        consoleThread.join();
+    }
+#endif
+    stopServer(server);
+    stopMetricsExport();
+    stopLogger();
+
+    printStreamStatus(server, false);
+    printMetricsSummary();
+    return 0;
+}
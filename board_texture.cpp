@@ -0,0 +1,98 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: an image laid onto the board plane with the homography of the current pose
+
+#include "board_texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include "alloc_counter.h"
+
+bool loadBoardTexture(const std::string &filename, BoardTexture &texture) {
+    cv::Mat image = cv::imread(filename, cv::IMREAD_COLOR);
+    if (image.empty()) {
+        return false;
+    }
+    buildTextureLevels(image, texture);
+    return true;
+}
+
+
+void buildTextureLevels(const cv::Mat &image, BoardTexture &texture) {
+    texture.levels.clear();
+    texture.levels.push_back(image);
+    while (std::min(texture.levels.back().cols, texture.levels.back().rows) >= 16) {
+        cv::Mat smaller;
+        cv::pyrDown(texture.levels.back(), smaller);
+        texture.levels.push_back(smaller);
+    }
+}
+
+
+cv::Rect2f boardArea(cv::Size boardSize) {
+    return cv::Rect2f(-1.0f, -(float)boardSize.height, (float)boardSize.width + 1, (float)boardSize.height + 1);
+}
+
+
+bool drawBoardTexture(BoardTexture &texture, cv::Mat &frame, const cv::Mat &rvec, const cv::Mat &tvec,
+                      const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff) {
+    if (texture.levels.empty()) {
+        return false;
+    }
+
+    // Corners of the textured area in the order of the texture's corners: top-left, top-right,
+    // bottom-right, bottom-left, with texture rows running down the board (-y)
+    const cv::Rect2f &area = texture.area;
+    texture.corners.resize(4);
+    texture.corners[0] = cv::Point3f(area.x, area.y + area.height, 0);
+    texture.corners[1] = cv::Point3f(area.x + area.width, area.y + area.height, 0);
+    texture.corners[2] = cv::Point3f(area.x + area.width, area.y, 0);
+    texture.corners[3] = cv::Point3f(area.x, area.y, 0);
+
+    // Nothing to draw when part of the quad is behind the camera
+    cv::Matx33d R;
+    {
+        LibraryScope library;
+        cv::Rodrigues(rvec, R);
+    }
+    for (const cv::Point3f &p : texture.corners) {
+        if (R(2, 0) * p.x + R(2, 1) * p.y + tvec.at<double>(2) <= 0) {
+            return false;
+        }
+    }
+
+    std::vector<cv::Point2f> &projected = texture.projected;
+    {
+        LibraryScope library;
+        cv::projectPoints(texture.corners, rvec, tvec, camera_matrix, dist_coeff, projected);
+    }
+    cv::Rect box = cv::boundingRect(projected) & cv::Rect(0, 0, frame.cols, frame.rows);
+    if (box.area() == 0) {
+        return false;
+    }
+
+    // The smallest mip level still at least as large as the board on screen
+    float screenWidth = (float)std::max(cv::norm(projected[1] - projected[0]), cv::norm(projected[2] - projected[3]));
+    float screenHeight = (float)std::max(cv::norm(projected[3] - projected[0]), cv::norm(projected[2] - projected[1]));
+    int level = 0;
+    while (level + 1 < (int)texture.levels.size() && texture.levels[level + 1].cols >= screenWidth &&
+           texture.levels[level + 1].rows >= screenHeight) {
+        ++level;
+    }
+    texture.lastLevel = level;
+    const cv::Mat &source = texture.levels[level];
+
+    // Texture corners to the quad, relative to the bounding box that is warped
+    cv::Point2f from[4] = {cv::Point2f(-0.5f, -0.5f), cv::Point2f(source.cols - 0.5f, -0.5f),
+                           cv::Point2f(source.cols - 0.5f, source.rows - 0.5f), cv::Point2f(-0.5f, source.rows - 0.5f)};
+    cv::Point2f to[4];
+    for (int i = 0; i < 4; ++i) {
+        to[i] = projected[i] - cv::Point2f((float)box.x, (float)box.y);
+    }
+
+    // Warp straight into the frame's box; the transparent border keeps the pixels around the quad
+    LibraryScope library;
+    cv::Mat homography = cv::getPerspectiveTransform(from, to);
+    cv::Mat target = frame(box);
+    cv::warpPerspective(source, target, homography, box.size(), cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+    return true;
+}
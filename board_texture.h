@@ -0,0 +1,40 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: an image laid onto the board plane with the homography of the current pose
+
+#ifndef BOARD_TEXTURE_H
+#define BOARD_TEXTURE_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// A texture loaded once with its mip pyramid: each level half the size of the one before,
+// down to a few pixels. Each frame uses the level closest to the board's size on screen, so
+// a small or distant board never samples the full-resolution image.
+struct BoardTexture {
+    std::vector<cv::Mat> levels;
+    cv::Rect2f area = cv::Rect2f(-1, -1, 1, 1);   // covered part of the board plane, set by the caller
+
+    // Scratch reused every frame
+    std::vector<cv::Point3f> corners;
+    std::vector<cv::Point2f> projected;
+
+    int lastLevel = 0;   // level used for the last frame
+};
+
+bool loadBoardTexture(const std::string &filename, BoardTexture &texture);
+
+// Make image the texture's full-resolution level and build the levels below it
+void buildTextureLevels(const cv::Mat &image, BoardTexture &texture);
+
+// The whole board for a board of boardSize inner corners, squares one unit apart: one square
+// beyond the outermost corners on every side, the first corner at the origin and rows going -y
+cv::Rect2f boardArea(cv::Size boardSize);
+
+// Warp the texture onto texture.area of the board plane at the given pose. Only the bounding
+// box of the projected quad is warped, and pixels outside the quad are left as they were.
+// Returns false when the board is behind the camera or off screen.
+bool drawBoardTexture(BoardTexture &texture, cv::Mat &frame, const cv::Mat &rvec, const cv::Mat &tvec,
+                      const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff);
+
+#endif
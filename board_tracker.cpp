@@ -0,0 +1,224 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: chessboard detection that tracks the board between frames instead of searching the full frame
+
+#include "board_tracker.h"
+#include "metrics.h"
+#include "alloc_counter.h"
+
+#include <algorithm>
+#include <cstdint>
+
+// The fast check rejects frames without a board early, which is where full searches are slowest
+static const int searchFlags = cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE + cv::CALIB_CB_FAST_CHECK;
+
+
+bool parseDetectMode(const std::string &name, DetectMode &mode) {
+    if (name == "full") {
+        mode = DETECT_FULL;
+    } else if (name == "roi") {
+        mode = DETECT_ROI;
+    } else if (name == "pyramid") {
+        mode = DETECT_PYRAMID;
+    } else if (name == "flow") {
+        mode = DETECT_FLOW;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+const char *detectModeName(DetectMode mode) {
+    switch (mode) {
+        case DETECT_FULL: return "full";
+        case DETECT_ROI: return "roi";
+        case DETECT_PYRAMID: return "pyramid";
+        default: return "flow";
+    }
+}
+
+
+const char *detectSourceName(DetectSource source) {
+    switch (source) {
+        case FOUND_FULL: return "full";
+        case FOUND_ROI: return "roi";
+        case FOUND_PYRAMID: return "pyramid";
+        case FOUND_FLOW: return "flow";
+        case FOUND_TARGETS: return "targets";
+        default: return "none";
+    }
+}
+
+
+// Grow a box by a fraction of its size on each side and clip it to the frame
+static cv::Rect padRegion(const cv::Rect2f &box, float padding, const cv::Rect &frameRect) {
+    float padX = box.width * padding + 8;
+    float padY = box.height * padding + 8;
+    cv::Rect region((int)(box.x - padX), (int)(box.y - padY),
+                    (int)(box.width + 2 * padX), (int)(box.height + 2 * padY));
+    return region & frameRect;
+}
+
+
+static cv::Rect2f pointBounds(const std::vector<cv::Point2f> &points) {
+    float minX = points[0].x, maxX = points[0].x, minY = points[0].y, maxY = points[0].y;
+    for (const cv::Point2f &p : points) {
+        minX = std::min(minX, p.x);
+        maxX = std::max(maxX, p.x);
+        minY = std::min(minY, p.y);
+        maxY = std::max(maxY, p.y);
+    }
+    return cv::Rect2f(minX, minY, maxX - minX, maxY - minY);
+}
+
+
+// Follow last frame's corners with pyramidal Lucas-Kanade
+static bool trackCorners(BoardTracker &tracker, const cv::Mat &gray, std::vector<cv::Point2f> &corners) {
+    std::vector<uchar> &status = tracker.flowStatus;
+    std::vector<float> &error = tracker.flowError;
+    LibraryScope library;
+    cv::calcOpticalFlowPyrLK(tracker.prevGray, gray, tracker.corners, corners, status, error, cv::Size(21, 21), 3);
+
+    cv::Rect frameRect(0, 0, gray.cols, gray.rows);
+    for (size_t i = 0; i < corners.size(); ++i) {
+        if (!status[i] || error[i] > tracker.maxFlowError || !frameRect.contains(cv::Point(corners[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool searchRegion(BoardTracker &tracker, const cv::Mat &gray, std::vector<cv::Point2f> &corners) {
+    cv::Rect roi = tracker.predicted & cv::Rect(0, 0, gray.cols, gray.rows);
+    LibraryScope library;
+    if (roi.area() == 0 || !cv::findChessboardCorners(gray(roi), tracker.boardSize, corners, searchFlags)) {
+        return false;
+    }
+    for (cv::Point2f &p : corners) {
+        p.x += roi.x;
+        p.y += roi.y;
+    }
+    return true;
+}
+
+
+static bool searchPyramid(BoardTracker &tracker, const cv::Mat &gray, std::vector<cv::Point2f> &corners) {
+    const cv::Mat *small = &tracker.searchImage;
+    if (tracker.sharedLevel && !tracker.sharedLevel->empty()) {
+        small = tracker.sharedLevel;
+    } else {
+        int levels = 0;
+        while ((gray.cols >> levels) > tracker.maxSearchWidth) {
+            ++levels;
+        }
+        if (levels == 0) {
+            return false;
+        }
+        OutputScope output(tracker.searchImage);
+        cv::resize(gray, tracker.searchImage, cv::Size(gray.cols >> levels, gray.rows >> levels), 0, 0, cv::INTER_AREA);
+    }
+
+    float scale = (float)gray.cols / small->cols;
+    {
+        LibraryScope library;
+        if (!cv::findChessboardCorners(*small, tracker.boardSize, corners, searchFlags)) {
+            return false;
+        }
+    }
+
+    // Back to full resolution pixel centres, cornerSubPix does the rest
+    for (cv::Point2f &p : corners) {
+        p.x = (p.x + 0.5f) * scale - 0.5f;
+        p.y = (p.y + 0.5f) * scale - 0.5f;
+    }
+    return true;
+}
+
+
+bool detectBoard(BoardTracker &tracker, const cv::Mat &gray, std::vector<cv::Point2f> &corners) {
+    static StageHistogram *searchStage = metricStage("search");
+    static StageHistogram *subPixStage = metricStage("subpix");
+    int64_t start = cv::getTickCount();
+
+    DetectSource source = FOUND_NONE;
+    int trackLimit = tracker.mode == DETECT_FLOW ? tracker.flowInterval : tracker.trackFrames;
+    if (trackLimit > 0 && tracker.found && !tracker.prevGray.empty() &&
+        tracker.trackedFrames < trackLimit && trackCorners(tracker, gray, corners)) {
+        source = FOUND_FLOW;
+    }
+    if (source == FOUND_NONE && (tracker.mode == DETECT_ROI || tracker.mode == DETECT_FLOW) &&
+        !tracker.predicted.empty() && searchRegion(tracker, gray, corners)) {
+        source = FOUND_ROI;
+    }
+    if (source == FOUND_NONE && (tracker.mode == DETECT_PYRAMID || tracker.scaledSearch) && searchPyramid(tracker, gray, corners)) {
+        source = FOUND_PYRAMID;
+    }
+    // Full-frame search only once the cheaper searches have lost the board
+    if (source == FOUND_NONE && tracker.fullSearch) {
+        LibraryScope library;
+        if (cv::findChessboardCorners(gray, tracker.boardSize, corners, searchFlags)) {
+            source = FOUND_FULL;
+        }
+    }
+    recordDuration(searchStage, (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency());
+
+    tracker.found = source != FOUND_NONE;
+    if (tracker.found) {
+        {
+            ScopedTimer timer(subPixStage);
+            LibraryScope library;
+            cv::cornerSubPix(gray, corners, tracker.subPixWindow, cv::Size(-1, -1), tracker.subPixCriteria);
+        }
+        tracker.corners = corners;
+        tracker.trackedFrames = source == FOUND_FLOW ? tracker.trackedFrames + 1 : 0;
+        tracker.predicted = padRegion(pointBounds(corners), tracker.roiPadding, cv::Rect(0, 0, gray.cols, gray.rows));
+    } else {
+        corners.clear();
+        tracker.corners.clear();
+        tracker.predicted = cv::Rect();
+    }
+
+    if (tracker.mode == DETECT_FLOW || tracker.trackFrames > 0) {
+        gray.copyTo(tracker.prevGray);
+    }
+
+    tracker.source = source;
+    tracker.detectMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+    tracker.totalMs += tracker.detectMs;
+    tracker.frames++;
+    return tracker.found;
+}
+
+
+void resetBoardTracker(BoardTracker &tracker) {
+    tracker.found = false;
+    tracker.corners.clear();
+    tracker.predicted = cv::Rect();
+    tracker.prevGray.release();
+    tracker.trackedFrames = 0;
+}
+
+
+void predictBoardRegion(BoardTracker &tracker, const cv::Mat &rvec, const cv::Mat &tvec,
+                        const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff, cv::Size frameSize) {
+    // Outer edge of the board: one square beyond the outermost inner corners
+    float w = (float)tracker.boardSize.width;
+    float h = (float)tracker.boardSize.height;
+    cv::Point3f outline[4] = { {-1, 1, 0}, {w, 1, 0}, {w, -h, 0}, {-1, -h, 0} };
+    std::vector<cv::Point2f> &projected = tracker.outlineProjected;
+    {
+        LibraryScope library;
+        cv::projectPoints(cv::Mat(4, 1, CV_32FC3, outline), rvec, tvec, camera_matrix, dist_coeff, projected);
+    }
+
+    cv::Rect frameRect(0, 0, frameSize.width, frameSize.height);
+    cv::Rect region = padRegion(pointBounds(projected), tracker.roiPadding, frameRect);
+
+    // Keep the region around the detected corners too, so a rough calibration can only widen the search
+    if (tracker.predicted.empty()) {
+        tracker.predicted = region;
+    } else if (region.area() > 0) {
+        tracker.predicted |= region;
+    }
+}
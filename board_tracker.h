@@ -0,0 +1,80 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: chessboard detection that tracks the board between frames instead of searching the full frame
+
+#ifndef BOARD_TRACKER_H
+#define BOARD_TRACKER_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// How the tracker looks for the board
+enum DetectMode {
+    DETECT_FULL,      // findChessboardCorners over the whole frame every time
+    DETECT_ROI,       // search the padded region predicted from the last pose first
+    DETECT_PYRAMID,   // search a downscaled pyramid level first, refine at full resolution
+    DETECT_FLOW       // optical-flow tracking between ROI detections
+};
+
+// Which search produced the corners of the last frame
+enum DetectSource {
+    FOUND_NONE,
+    FOUND_FULL,
+    FOUND_ROI,
+    FOUND_PYRAMID,
+    FOUND_FLOW,
+    FOUND_TARGETS     // several targets fused, see target_set.h
+};
+
+struct BoardTracker {
+    cv::Size boardSize = cv::Size(6, 9);
+    DetectMode mode = DETECT_ROI;
+
+    // Settings
+    float roiPadding = 0.3f;     // ROI growth on each side, as a fraction of the board's extent
+    int maxSearchWidth = 800;    // pyramid search runs on the first level at most this wide
+    int flowInterval = 10;       // full detection at least every this many tracked frames
+    int trackFrames = 0;         // other modes: frames followed with optical flow between searches
+    bool scaledSearch = false;   // other modes: search the pyramid level first as in DETECT_PYRAMID
+    bool fullSearch = true;      // fall back to the full frame when the cheaper searches fail
+    const cv::Mat *sharedLevel = nullptr;   // downscaled frame made once for several trackers, instead of their own
+    float maxFlowError = 12.0f;  // reject a flow track if any corner's error is above this
+    cv::Size subPixWindow = cv::Size(11, 11);
+    cv::TermCriteria subPixCriteria = cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 100, 0.001);
+
+    // State carried between frames
+    bool found = false;
+    std::vector<cv::Point2f> corners;
+    cv::Rect predicted;          // where the board is expected in the next frame, empty if unknown
+    cv::Mat prevGray;
+    int trackedFrames = 0;
+
+    // Scratch buffers reused from frame to frame
+    std::vector<uchar> flowStatus;
+    std::vector<float> flowError;
+    cv::Mat searchImage;
+    std::vector<cv::Point2f> outlineProjected;
+
+    // Timing of the last call and running totals, in milliseconds
+    DetectSource source = FOUND_NONE;
+    double detectMs = 0;
+    double totalMs = 0;
+    int frames = 0;
+};
+
+bool parseDetectMode(const std::string &name, DetectMode &mode);
+const char *detectModeName(DetectMode mode);
+const char *detectSourceName(DetectSource source);
+
+// Find the board corners in a grey frame, refined with cornerSubPix.
+// Returns false if the board was not found; corners is then left empty.
+bool detectBoard(BoardTracker &tracker, const cv::Mat &gray, std::vector<cv::Point2f> &corners);
+
+// Forget the board, e.g. when the stream restarts; the next frame is searched from scratch
+void resetBoardTracker(BoardTracker &tracker);
+
+// Predict next frame's search region by projecting the board outline at the current pose
+void predictBoardRegion(BoardTracker &tracker, const cv::Mat &rvec, const cv::Mat &tvec,
+                        const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff, cv::Size frameSize);
+
+#endif
@@ -0,0 +1,120 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: saved calibrations, keyed by camera and resolution, so startup skips recalibrating
+
+#include "calib_store.h"
+
+#include <cctype>
+#include <cstdio>
+#include <opencv2/core/utils/filesystem.hpp>
+
+std::string calibrationPath(const std::string &dir, const std::string &cameraId, cv::Size imageSize) {
+    char name[256];
+    snprintf(name, sizeof(name), "%s_%dx%d.yaml", cameraId.c_str(), imageSize.width, imageSize.height);
+    return dir.empty() ? std::string(name) : cv::utils::fs::join(dir, name);
+}
+
+
+std::string cameraIdFor(const std::string &inputSpec) {
+    bool index = !inputSpec.empty();
+    for (char c : inputSpec) {
+        index = index && isdigit((unsigned char)c);
+    }
+    if (index) {
+        return "camera" + inputSpec;
+    }
+
+    // File name without directories, anything but letters and digits becomes '_'
+    size_t slash = inputSpec.find_last_of("/\\");
+    std::string id = slash == std::string::npos ? inputSpec : inputSpec.substr(slash + 1);
+    for (char &c : id) {
+        if (!isalnum((unsigned char)c)) {
+            c = '_';
+        }
+    }
+    return id.empty() ? std::string("camera") : id;
+}
+
+
+bool loadCalibration(const std::string &path, cv::Size imageSize, StoredCalibration &calibration) {
+    cv::FileStorage fs;
+    try {
+        if (!fs.open(path, cv::FileStorage::READ)) {
+            return false;
+        }
+    } catch (const cv::Exception &) {
+        return false;
+    }
+
+    cv::Mat camera_matrix;
+    fs["camera_matrix"] >> camera_matrix;
+    if (camera_matrix.rows != 3 || camera_matrix.cols != 3) {
+        return false;
+    }
+
+    cv::Size storedSize((int)fs["image_width"], (int)fs["image_height"]);
+    if (imageSize.area() > 0 && storedSize.area() > 0 && storedSize != imageSize) {
+        return false;
+    }
+
+    calibration.cameraId = (std::string)fs["camera_id"];
+    calibration.imageSize = storedSize.area() > 0 ? storedSize : imageSize;
+    camera_matrix.convertTo(calibration.camera_matrix, CV_64F);
+    calibration.distortion_coefficients.clear();
+    fs["distortion_coefficients"] >> calibration.distortion_coefficients;
+    calibration.error = (double)fs["rms_error"];
+
+    // Views as Nx2 corner and Nx3 world point matrices
+    calibration.views.clear();
+    cv::FileNode views = fs["views"];
+    for (size_t i = 0; i < views.size(); ++i) {
+        cv::Mat corners, points;
+        views[(int)i]["corners"] >> corners;
+        views[(int)i]["points"] >> points;
+        if (corners.empty() || corners.rows != points.rows || corners.cols != 2 || points.cols != 3 ||
+            corners.channels() != 1 || points.channels() != 1) {
+            continue;
+        }
+        // Hand-edited files may hold doubles
+        corners.convertTo(corners, CV_32F);
+        points.convertTo(points, CV_32F);
+        CalibrationView view;
+        view.corners.assign(corners.ptr<cv::Point2f>(0), corners.ptr<cv::Point2f>(0) + corners.rows);
+        view.points.assign(points.ptr<cv::Vec3f>(0), points.ptr<cv::Vec3f>(0) + points.rows);
+        calibration.views.push_back(view);
+    }
+    return true;
+}
+
+
+bool saveCalibration(const std::string &path, const StoredCalibration &calibration) {
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        cv::utils::fs::createDirectories(path.substr(0, slash));
+    }
+
+    // Keep the extension so FileStorage still picks the format (and compression) from it
+    size_t nameStart = slash == std::string::npos ? 0 : slash + 1;
+    std::string temporary = path.substr(0, nameStart) + "tmp_" + path.substr(nameStart);
+    {
+        cv::FileStorage fs(temporary, cv::FileStorage::WRITE);
+        if (!fs.isOpened()) {
+            return false;
+        }
+        fs << "camera_id" << calibration.cameraId;
+        fs << "image_width" << calibration.imageSize.width;
+        fs << "image_height" << calibration.imageSize.height;
+        fs << "camera_matrix" << calibration.camera_matrix;
+        fs << "distortion_coefficients" << calibration.distortion_coefficients;
+        fs << "rms_error" << calibration.error;
+
+        fs << "views" << "[";
+        for (const CalibrationView &view : calibration.views) {
+            cv::Mat corners((int)view.corners.size(), 2, CV_32F, (void *)view.corners.data());
+            cv::Mat points((int)view.points.size(), 3, CV_32F, (void *)view.points.data());
+            fs << "{" << "corners" << corners << "points" << points << "}";
+        }
+        fs << "]";
+        fs.release();
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
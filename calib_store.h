@@ -0,0 +1,39 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: saved calibrations, keyed by camera and resolution, so startup skips recalibrating
+
+#ifndef CALIB_STORE_H
+#define CALIB_STORE_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "calib_worker.h"
+
+// One camera's calibration as saved on disk: the intrinsics and the views they were solved
+// from, so a later run can show correct overlays on its first frame and keep adding views.
+// Written as YAML with the camera_matrix / distortion_coefficients keys of
+// intrinsic_params.yaml; a ".yml.gz" path stores it compressed.
+struct StoredCalibration {
+    std::string cameraId;
+    cv::Size imageSize;
+    cv::Mat camera_matrix;
+    std::vector<double> distortion_coefficients;
+    double error = 0;   // RMS re-projection error of the solve, in pixels
+    std::vector<CalibrationView> views;
+};
+
+// File name of a camera's calibration at one resolution, e.g. calibration/camera0_1280x720.yaml
+std::string calibrationPath(const std::string &dir, const std::string &cameraId, cv::Size imageSize);
+
+// Camera ID for an input spec: "0" -> "camera0", "rec/desk.mp4" -> "desk_mp4"
+std::string cameraIdFor(const std::string &inputSpec);
+
+// Load a saved calibration. A file that records a different resolution than imageSize is
+// rejected (pass an empty size to accept any). Files without views, such as the
+// intrinsic_params.yaml written by older builds, load with an empty view list.
+bool loadCalibration(const std::string &path, cv::Size imageSize, StoredCalibration &calibration);
+
+// Write through a temporary file and rename, so a crash never leaves a truncated store
+bool saveCalibration(const std::string &path, const StoredCalibration &calibration);
+
+#endif
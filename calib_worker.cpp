@@ -0,0 +1,239 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: camera calibration solved on a background thread as views are added
+
+#include "calib_worker.h"
+#include "calib_store.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+
+std::vector<double> viewDescriptor(const CalibrationView &view, cv::Size imageSize) {
+    // Image positions of the four outermost grid corners, found from the world grid
+    int extreme[4] = {0, 0, 0, 0};
+    const int signs[4][2] = { {-1, 1}, {1, 1}, {1, -1}, {-1, -1} };
+    for (int k = 0; k < 4; ++k) {
+        float best = -FLT_MAX;
+        for (size_t i = 0; i < view.points.size(); ++i) {
+            float score = signs[k][0] * view.points[i][0] + signs[k][1] * view.points[i][1];
+            if (score > best) {
+                best = score;
+                extreme[k] = (int)i;
+            }
+        }
+    }
+    cv::Point2f q[4];
+    for (int k = 0; k < 4; ++k) {
+        q[k] = view.corners[extreme[k]];
+    }
+
+    double diag = std::sqrt((double)imageSize.width * imageSize.width + (double)imageSize.height * imageSize.height);
+    cv::Point2f center = (q[0] + q[1] + q[2] + q[3]) * 0.25;
+    double area = 0.5 * std::fabs((q[2] - q[0]).cross(q[3] - q[1]));
+    double top = cv::norm(q[1] - q[0]) + 1e-6, bottom = cv::norm(q[2] - q[3]) + 1e-6;
+    double left = cv::norm(q[3] - q[0]) + 1e-6, right = cv::norm(q[2] - q[1]) + 1e-6;
+    double angle = std::atan2(q[1].y - q[0].y, q[1].x - q[0].x);
+
+    return {
+        center.x / imageSize.width,
+        center.y / imageSize.height,
+        std::sqrt(area) / diag,
+        std::log(top / bottom),
+        std::log(left / right),
+        0.25 * std::cos(angle),
+        0.25 * std::sin(angle)
+    };
+}
+
+
+std::vector<int> selectDiverseViews(const std::vector<CalibrationView> &views, cv::Size imageSize, int maxViews) {
+    int n = (int)views.size();
+    std::vector<int> selected;
+    if (maxViews <= 0 || n <= maxViews) {
+        for (int i = 0; i < n; ++i) {
+            selected.push_back(i);
+        }
+        return selected;
+    }
+
+    std::vector<std::vector<double>> descriptors;
+    for (const CalibrationView &view : views) {
+        descriptors.push_back(viewDescriptor(view, imageSize));
+    }
+
+    // Farthest point sampling, starting from the newest view
+    std::vector<double> nearest(n, DBL_MAX);
+    int next = n - 1;
+    while ((int)selected.size() < maxViews) {
+        selected.push_back(next);
+        nearest[next] = -1;
+        int farthest = -1;
+        for (int i = 0; i < n; ++i) {
+            if (nearest[i] < 0) {
+                continue;
+            }
+            double d = 0;
+            for (size_t k = 0; k < descriptors[i].size(); ++k) {
+                double diff = descriptors[i][k] - descriptors[next][k];
+                d += diff * diff;
+            }
+            nearest[i] = std::min(nearest[i], d);
+            if (farthest < 0 || nearest[i] > nearest[farthest]) {
+                farthest = i;
+            }
+        }
+        next = farthest;
+    }
+
+    std::sort(selected.begin(), selected.end());
+    return selected;
+}
+
+
+static void solve(CalibrationWorker &worker, const std::vector<CalibrationView> &views) {
+    int64_t start = cv::getTickCount();
+
+    std::vector<int> used = selectDiverseViews(views, worker.imageSize, worker.maxViews);
+    std::vector<std::vector<cv::Vec3f>> point_list;
+    std::vector<std::vector<cv::Point2f>> corner_list;
+    for (int i : used) {
+        point_list.push_back(views[i].points);
+        corner_list.push_back(views[i].corners);
+    }
+
+    // Warm start from the intrinsics in use, once they are a real calibration
+    IntrinsicsPtr current = loadIntrinsics(*worker.shared);
+    cv::Mat camera_matrix = current->camera_matrix.clone();
+    std::vector<double> distortion_coefficients = current->distortion_coefficients;
+    int flags = 0;
+    if (camera_matrix.at<double>(0, 0) > 1.0 && camera_matrix.at<double>(1, 1) > 1.0) {
+        flags |= cv::CALIB_USE_INTRINSIC_GUESS;
+        if (distortion_coefficients.size() < 5) {
+            distortion_coefficients.resize(5, 0.0);
+        }
+    }
+
+    std::vector<cv::Mat> rotations, translations;
+    double error = cv::calibrateCamera(point_list, corner_list, worker.imageSize, camera_matrix,
+                                       distortion_coefficients, rotations, translations, flags);
+
+    // Swap the new intrinsics in for every reader at once
+    storeIntrinsics(*worker.shared, makeIntrinsics(camera_matrix, distortion_coefficients));
+
+    worker.lastError = error;
+    worker.lastViewCount = (int)used.size();
+    double solveMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+    worker.lastSolveMs = solveMs;
+    worker.solves++;
+
+    // Print camera matrix, distortion coefficients, and re-projection error
+    std::cout << "Old Camera Matrix:\n" << current->camera_matrix << "\n";
+    std::cout << "Camera Matrix:\n" << camera_matrix << "\n";
+
+    std::cout << "Distortion Coefficients:\n";
+    for (size_t i = 0; i < distortion_coefficients.size(); ++i) {
+        std::cout << distortion_coefficients[i] << " ";
+    }
+    std::cout << "\n";
+    std::cout << "Re-projection Error: " << error << "\n";
+    std::cout << "Solved over " << used.size() << " of " << views.size() << " views in " << solveMs << " ms\n\n";
+
+    std::cout << "rotations:\n";
+    for (size_t i = 0; i < rotations.size(); ++i) {
+        std::cout << "Rotation matrix " << i << ":\n" << rotations[i] << "\n";
+    }
+
+    std::cout << "translations:\n";
+    for (size_t i = 0; i < translations.size(); ++i) {
+        std::cout << "Translation matrix " << i << ":\n" << translations[i] << "\n";
+    }
+
+    // Save intrinsic parameters to a file
+    cv::FileStorage fs(worker.outputFile, cv::FileStorage::WRITE);
+    fs << "camera_matrix" << camera_matrix;
+    fs << "Rotaion matrices" << rotations;
+
+    fs << "Translation matrices" << translations;
+
+    fs << "distortion_coefficients" << distortion_coefficients;
+    fs.release();
+
+    // Keep every view with the intrinsics, so the next run starts calibrated and can resume
+    if (!worker.storeFile.empty()) {
+        StoredCalibration stored;
+        stored.cameraId = worker.cameraId;
+        stored.imageSize = worker.imageSize;
+        stored.camera_matrix = camera_matrix;
+        stored.distortion_coefficients = distortion_coefficients;
+        stored.error = error;
+        stored.views = views;
+        if (!saveCalibration(worker.storeFile, stored)) {
+            std::cerr << "Error: Could not save calibration to " << worker.storeFile << std::endl;
+        }
+    }
+}
+
+
+static void calibrationLoop(CalibrationWorker &worker) {
+    std::vector<CalibrationView> views;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.wake.wait(lock, [&worker] { return worker.pending || worker.stopping; });
+            if (worker.stopping) {
+                return;
+            }
+            // Take a snapshot so new views can be added while this one solves
+            views = worker.views;
+            worker.pending = false;
+            worker.busy = true;
+        }
+        solve(worker, views);
+        worker.busy = false;
+    }
+}
+
+
+void startCalibrationWorker(CalibrationWorker &worker, IntrinsicsPtr &shared, cv::Size imageSize) {
+    worker.shared = &shared;
+    worker.imageSize = imageSize;
+    worker.thread = std::thread(calibrationLoop, std::ref(worker));
+}
+
+
+void addCalibrationView(CalibrationWorker &worker, const std::vector<cv::Point2f> &corners,
+                        const std::vector<cv::Vec3f> &points) {
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        CalibrationView view;
+        view.corners = corners;
+        view.points = points;
+        worker.views.push_back(view);
+        worker.pending = true;
+    }
+    worker.wake.notify_one();
+}
+
+
+void restoreCalibrationViews(CalibrationWorker &worker, const std::vector<CalibrationView> &views) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.views.insert(worker.views.end(), views.begin(), views.end());
+}
+
+
+int calibrationViewCount(CalibrationWorker &worker) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    return (int)worker.views.size();
+}
+
+
+void stopCalibrationWorker(CalibrationWorker &worker) {
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.stopping = true;
+    }
+    worker.wake.notify_one();
+    if (worker.thread.joinable()) {
+        worker.thread.join();
+    }
+}
@@ -0,0 +1,72 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: camera calibration solved on a background thread as views are added
+
+#ifndef CALIB_WORKER_H
+#define CALIB_WORKER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "intrinsics.h"
+
+// One saved view of the board: image corners and matching world points
+struct CalibrationView {
+    std::vector<cv::Point2f> corners;
+    std::vector<cv::Vec3f> points;
+};
+
+// Runs calibrateCamera off the UI thread. Each solve starts from the current intrinsics
+// and publishes its result to the shared snapshot in one atomic swap. Views added while a
+// solve is running are picked up by one follow-up solve.
+struct CalibrationWorker {
+    // Settings
+    cv::Size imageSize;
+    int maxViews = 0;   // 0 solves over every view, otherwise over a pose-diverse subset of at most this many
+    std::string outputFile = "intrinsic_params.yaml";
+    std::string storeFile;   // calibration store updated after every solve (see calib_store.h), empty skips it
+    std::string cameraId;
+
+    IntrinsicsPtr *shared = nullptr;
+
+    // Guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<CalibrationView> views;
+    bool pending = false;
+    bool stopping = false;
+
+    std::thread thread;
+    std::atomic<bool> busy{false};
+
+    // Result of the last solve
+    std::atomic<int> solves{0};
+    std::atomic<double> lastError{0};
+    std::atomic<double> lastSolveMs{0};
+    std::atomic<int> lastViewCount{0};
+};
+
+void startCalibrationWorker(CalibrationWorker &worker, IntrinsicsPtr &shared, cv::Size imageSize);
+
+// Queue a view and request a new solve; returns immediately
+void addCalibrationView(CalibrationWorker &worker, const std::vector<cv::Point2f> &corners,
+                        const std::vector<cv::Vec3f> &points);
+
+// Add views saved by an earlier run without solving; the next 's' solves over all of them
+void restoreCalibrationViews(CalibrationWorker &worker, const std::vector<CalibrationView> &views);
+
+int calibrationViewCount(CalibrationWorker &worker);
+
+// Where and how the board sits in a view (position, size, foreshortening, rotation), scaled
+// so that views a calibration cannot tell apart are close together
+std::vector<double> viewDescriptor(const CalibrationView &view, cv::Size imageSize);
+
+// Indices of at most maxViews views that cover the widest range of board positions, sizes and tilts
+std::vector<int> selectDiverseViews(const std::vector<CalibrationView> &views, cv::Size imageSize, int maxViews);
+
+void stopCalibrationWorker(CalibrationWorker &worker);
+
+#endif
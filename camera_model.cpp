@@ -0,0 +1,75 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: compile-time board grids and projection kernels specialised per distortion model
+
+#include "camera_model.h"
+#include "alloc_counter.h"
+
+bool makeProjectionCamera(const cv::Mat &rvec, const cv::Mat &tvec, const cv::Mat &camera_matrix,
+                          const std::vector<double> &dist_coeff, ProjectionCamera &camera) {
+    // The cheapest model that still covers the last non-zero coefficient
+    int last = -1;
+    for (int i = 0; i < (int)dist_coeff.size(); ++i) {
+        if (dist_coeff[i] != 0) {
+            last = i;
+        }
+    }
+    if (last >= 8) {
+        return false;
+    }
+    camera.model = last < 0 ? DISTORTION_NONE : last < 2 ? DISTORTION_RADIAL2 : last < 5 ? DISTORTION_FULL5 : DISTORTION_FULL8;
+    for (int i = 0; i < 8; ++i) {
+        camera.k[i] = i <= last ? (float)dist_coeff[i] : 0.0f;
+    }
+
+    cv::Matx33d R;
+    {
+        LibraryScope library;
+        cv::Rodrigues(rvec, R);
+    }
+    for (int i = 0; i < 9; ++i) {
+        camera.R[i] = (float)R.val[i];
+    }
+    for (int i = 0; i < 3; ++i) {
+        camera.t[i] = (float)tvec.at<double>(i);
+    }
+    camera.fx = (float)camera_matrix.at<double>(0, 0);
+    camera.fy = (float)camera_matrix.at<double>(1, 1);
+    camera.cx = (float)camera_matrix.at<double>(0, 2);
+    camera.cy = (float)camera_matrix.at<double>(1, 2);
+    return true;
+}
+
+
+const char *distortionModelName(DistortionModel model) {
+    switch (model) {
+        case DISTORTION_NONE: return "none";
+        case DISTORTION_RADIAL2: return "k1-k2";
+        case DISTORTION_FULL5: return "5-coef";
+        default: return "8-coef";
+    }
+}
+
+
+void projectCamera(const ProjectionCamera &camera, const cv::Point3f *points, int count, cv::Point2f *projected) {
+    switch (camera.model) {
+        case DISTORTION_NONE: projectKernel<DISTORTION_NONE>(camera, points, count, projected); break;
+        case DISTORTION_RADIAL2: projectKernel<DISTORTION_RADIAL2>(camera, points, count, projected); break;
+        case DISTORTION_FULL5: projectKernel<DISTORTION_FULL5>(camera, points, count, projected); break;
+        default: projectKernel<DISTORTION_FULL8>(camera, points, count, projected); break;
+    }
+}
+
+
+void projectFast(const cv::Point3f *points, int count, const cv::Mat &rvec, const cv::Mat &tvec,
+                 const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff, std::vector<cv::Point2f> &projected) {
+    ProjectionCamera camera;
+    if (!makeProjectionCamera(rvec, tvec, camera_matrix, dist_coeff, camera)) {
+        LibraryScope library;
+        cv::projectPoints(cv::Mat(count, 1, CV_32FC3, (void *)points), rvec, tvec, camera_matrix, dist_coeff, projected);
+        return;
+    }
+    projected.resize(count);
+    if (count > 0) {
+        projectCamera(camera, points, count, projected.data());
+    }
+}
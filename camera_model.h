@@ -0,0 +1,182 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: compile-time board grids and projection kernels specialised per distortion model
+
+#ifndef CAMERA_MODEL_H
+#define CAMERA_MODEL_H
+
+#include <array>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "simd_compat.h"
+
+// Lens models in OpenCV's coefficient order (k1, k2, p1, p2, k3, k4, k5, k6), cheapest first.
+// A calibration uses the cheapest model that covers its non-zero coefficients.
+enum DistortionModel {
+    DISTORTION_NONE,      // pinhole
+    DISTORTION_RADIAL2,   // k1, k2
+    DISTORTION_FULL5,     // k1, k2, p1, p2, k3
+    DISTORTION_FULL8      // plus the rational k4, k5, k6
+};
+
+// Camera and board pose folded into floats once per frame, for the kernels below
+struct ProjectionCamera {
+    DistortionModel model = DISTORTION_NONE;
+    float R[9];
+    float t[3];
+    float fx, fy, cx, cy;
+    float k[8];
+};
+
+// False when the coefficients need more than DISTORTION_FULL8 (thin prism or tilt terms);
+// such calibrations have to go through cv::projectPoints
+bool makeProjectionCamera(const cv::Mat &rvec, const cv::Mat &tvec, const cv::Mat &camera_matrix,
+                          const std::vector<double> &dist_coeff, ProjectionCamera &camera);
+
+const char *distortionModelName(DistortionModel model);
+
+// Arithmetic of the lens model on single floats and on SIMD lanes. The vector operators are
+// deprecated (and missing on the scalable backends), so lanes go through v_add and friends.
+inline float laneAdd(float a, float b) { return a + b; }
+inline float laneMul(float a, float b) { return a * b; }
+inline float laneDiv(float a, float b) { return a / b; }
+#if CV_SIMD && !CV_SIMD_SCALABLE
+inline cv::v_float32 laneAdd(const cv::v_float32 &a, const cv::v_float32 &b) { return cv::v_add(a, b); }
+inline cv::v_float32 laneMul(const cv::v_float32 &a, const cv::v_float32 &b) { return cv::v_mul(a, b); }
+inline cv::v_float32 laneDiv(const cv::v_float32 &a, const cv::v_float32 &b) { return cv::v_div(a, b); }
+#endif
+
+// Apply the lens model to normalised image coordinates. The same code runs on single floats
+// and on SIMD lanes; terms a model does not have are removed at compile time.
+template <DistortionModel Model, typename T>
+inline void distortPoint(T &x, T &y, const T *k, const T &one, const T &two) {
+    if constexpr (Model != DISTORTION_NONE) {
+        T r2 = laneAdd(laneMul(x, x), laneMul(y, y));
+        T radial;
+        if constexpr (Model == DISTORTION_RADIAL2) {
+            radial = laneAdd(one, laneMul(r2, laneAdd(k[0], laneMul(r2, k[1]))));
+        } else {
+            radial = laneAdd(one, laneMul(r2, laneAdd(k[0], laneMul(r2, laneAdd(k[1], laneMul(r2, k[4]))))));
+        }
+        if constexpr (Model == DISTORTION_FULL8) {
+            radial = laneDiv(radial, laneAdd(one, laneMul(r2, laneAdd(k[5], laneMul(r2, laneAdd(k[6], laneMul(r2, k[7])))))));
+        }
+        if constexpr (Model == DISTORTION_RADIAL2) {
+            x = laneMul(x, radial);
+            y = laneMul(y, radial);
+        } else {
+            T xy2 = laneMul(laneMul(two, x), y);
+            T dx = laneAdd(laneMul(k[2], xy2), laneMul(k[3], laneAdd(r2, laneMul(laneMul(two, x), x))));
+            T dy = laneAdd(laneMul(k[2], laneAdd(r2, laneMul(laneMul(two, y), y))), laneMul(k[3], xy2));
+            x = laneAdd(laneMul(x, radial), dx);
+            y = laneAdd(laneMul(y, radial), dy);
+        }
+    }
+}
+
+
+// projectPoints without derivatives for one lens model: a vector of lanes at a time, then
+// the remaining points one by one with the same arithmetic
+template <DistortionModel Model>
+void projectKernel(const ProjectionCamera &camera, const cv::Point3f *points, int count, cv::Point2f *projected) {
+    const float *R = camera.R, *t = camera.t;
+    const float *src = &points[0].x;
+    float *dst = &projected[0].x;
+    int i = 0;
+#if CV_SIMD && !CV_SIMD_SCALABLE
+    // Arrays of vectors, which scalable vectors cannot be
+    const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+    cv::v_float32 r[9], tv[3], k[8];
+    for (int j = 0; j < 9; ++j) {
+        r[j] = cv::vx_setall_f32(R[j]);
+    }
+    for (int j = 0; j < 3; ++j) {
+        tv[j] = cv::vx_setall_f32(t[j]);
+    }
+    for (int j = 0; j < 8; ++j) {
+        k[j] = cv::vx_setall_f32(camera.k[j]);
+    }
+    cv::v_float32 fx = cv::vx_setall_f32(camera.fx), fy = cv::vx_setall_f32(camera.fy);
+    cv::v_float32 cx = cv::vx_setall_f32(camera.cx), cy = cv::vx_setall_f32(camera.cy);
+    cv::v_float32 vone = cv::vx_setall_f32(1.0f), vtwo = cv::vx_setall_f32(2.0f);
+    for (; i <= count - lanes; i += lanes) {
+        cv::v_float32 x, y, z;
+        cv::v_load_deinterleave(src + 3 * i, x, y, z);
+        cv::v_float32 X = cv::v_fma(r[0], x, cv::v_fma(r[1], y, cv::v_fma(r[2], z, tv[0])));
+        cv::v_float32 Y = cv::v_fma(r[3], x, cv::v_fma(r[4], y, cv::v_fma(r[5], z, tv[1])));
+        cv::v_float32 Z = cv::v_fma(r[6], x, cv::v_fma(r[7], y, cv::v_fma(r[8], z, tv[2])));
+        cv::v_float32 iz = cv::v_div(vone, Z);
+        cv::v_float32 xn = cv::v_mul(X, iz), yn = cv::v_mul(Y, iz);
+        distortPoint<Model>(xn, yn, k, vone, vtwo);
+        cv::v_store_interleave(dst + 2 * i, cv::v_fma(fx, xn, cx), cv::v_fma(fy, yn, cy));
+    }
+    cv::vx_cleanup();
+#endif
+    const float one = 1.0f, two = 2.0f;
+    for (; i < count; ++i) {
+        float x = src[3 * i], y = src[3 * i + 1], z = src[3 * i + 2];
+        float iz = 1.0f / (R[6] * x + R[7] * y + R[8] * z + t[2]);
+        float xn = (R[0] * x + R[1] * y + R[2] * z + t[0]) * iz;
+        float yn = (R[3] * x + R[4] * y + R[5] * z + t[1]) * iz;
+        distortPoint<Model>(xn, yn, camera.k, one, two);
+        dst[2 * i] = camera.fx * xn + camera.cx;
+        dst[2 * i + 1] = camera.fy * yn + camera.cy;
+    }
+}
+
+// The kernel for the camera's model
+void projectCamera(const ProjectionCamera &camera, const cv::Point3f *points, int count, cv::Point2f *projected);
+
+// projectPoints through the kernels, falling back to cv::projectPoints for models they do not cover
+void projectFast(const cv::Point3f *points, int count, const cv::Mat &rvec, const cv::Mat &tvec,
+                 const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff, std::vector<cv::Point2f> &projected);
+
+
+// Inner corners of a chessboard, corner (row i, column j) at (j, -i, 0) in squares, in the
+// order findChessboardCorners reports them. Built by the compiler.
+template <int Width, int Height>
+constexpr std::array<float, 3 * Width * Height> boardCoordinates() {
+    std::array<float, 3 * Width * Height> coordinates{};
+    for (int i = 0; i < Height; ++i) {
+        for (int j = 0; j < Width; ++j) {
+            coordinates[3 * (i * Width + j)] = (float)j;
+            coordinates[3 * (i * Width + j) + 1] = (float)-i;
+        }
+    }
+    return coordinates;
+}
+
+template <int Width, int Height>
+struct BoardGrid {
+    static constexpr int width = Width;
+    static constexpr int height = Height;
+    static constexpr int corners = Width * Height;
+    static constexpr std::array<float, 3 * corners> coordinates = boardCoordinates<Width, Height>();
+    static_assert(coordinates[3 * corners - 3] == Width - 1 && coordinates[3 * corners - 2] == 1 - Height,
+                  "last corner at the far end of the grid");
+
+    static cv::Size size() {
+        return cv::Size(Width, Height);
+    }
+    static const cv::Point3f *points() {
+        return reinterpret_cast<const cv::Point3f *>(coordinates.data());
+    }
+    // For the OpenCV calls that take a vector, e.g. solvePnP and calibrateCamera
+    static std::vector<cv::Vec3f> objectPoints(float squareSize = 1.0f) {
+        std::vector<cv::Vec3f> points(corners);
+        for (int i = 0; i < corners; ++i) {
+            points[i] = cv::Vec3f(coordinates[3 * i], coordinates[3 * i + 1], coordinates[3 * i + 2]) * squareSize;
+        }
+        return points;
+    }
+};
+
+// The printed checkerboard
+typedef BoardGrid<6, 9> DemoBoard;
+
+// Project a board's corners with the kernel for one model; the corner count is a constant
+template <class Board, DistortionModel Model>
+void projectBoard(const ProjectionCamera &camera, cv::Point2f (&projected)[Board::corners]) {
+    projectKernel<Model>(camera, Board::points(), Board::corners, projected);
+}
+
+#endif
@@ -0,0 +1,89 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: frames from a camera, a recorded video or an image sequence
+
+#include "frame_source.h"
+
+#include <algorithm>
+#include <cctype>
+#include <opencv2/core/utils/filesystem.hpp>
+
+static bool isCameraIndex(const std::string &spec) {
+    return !spec.empty() && std::all_of(spec.begin(), spec.end(), [](char c) { return isdigit((unsigned char)c); });
+}
+
+
+std::vector<std::string> listImages(const std::string &spec) {
+    std::vector<std::string> files;
+    bool directory = cv::utils::fs::isDirectory(spec);
+    if (!directory && spec.find('*') == std::string::npos) {
+        return files;
+    }
+    std::vector<cv::String> matches;
+    cv::glob(directory ? cv::utils::fs::join(spec, "*") : spec, matches, false);
+    for (const cv::String &file : matches) {
+        if (cv::haveImageReader(file)) {
+            files.push_back(file);
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+
+bool openFrameSource(const std::string &spec, FrameSource &source) {
+    source.spec = spec;
+    source.files.clear();
+    source.nextFile = 0;
+    source.live = isCameraIndex(spec);
+
+    if (source.live) {
+        return source.capture.open(atoi(spec.c_str()));
+    }
+
+    if (cv::utils::fs::isDirectory(spec) || spec.find('*') != std::string::npos) {
+        source.files = listImages(spec);
+        return !source.files.empty();
+    }
+
+    return source.capture.open(spec);
+}
+
+
+bool readFrame(FrameSource &source, cv::Mat &frame) {
+    if (source.capture.isOpened()) {
+        return source.capture.read(frame) && !frame.empty();
+    }
+    while (source.nextFile < source.files.size()) {
+        // Decoded into a new image every time; copied so the caller's frame buffer is reused
+        cv::Mat image = cv::imread(source.files[source.nextFile++]);
+        if (!image.empty()) {
+            image.copyTo(frame);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+cv::Size frameSourceSize(FrameSource &source) {
+    if (source.capture.isOpened()) {
+        return cv::Size((int)source.capture.get(cv::CAP_PROP_FRAME_WIDTH), (int)source.capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    }
+    for (const std::string &file : source.files) {
+        cv::Mat first = cv::imread(file);
+        if (!first.empty()) {
+            return first.size();
+        }
+    }
+    return cv::Size();
+}
+
+
+bool loadFrames(FrameSource &source, std::vector<cv::Mat> &frames, int maxFrames) {
+    frames.clear();
+    cv::Mat frame;
+    while ((maxFrames <= 0 || (int)frames.size() < maxFrames) && readFrame(source, frame)) {
+        frames.push_back(frame.clone());
+    }
+    return !frames.empty();
+}
@@ -0,0 +1,38 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: frames from a camera, a recorded video or an image sequence
+
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// One input stream. The spec decides the kind:
+//   "0", "1", ...          camera index
+//   a directory            every image in it, in name order
+//   a pattern with '*'     every matching file, in name order (e.g. "frames/*.png")
+//   anything else          opened by cv::VideoCapture (video files and "img_%04d.png" sequences)
+struct FrameSource {
+    std::string spec;
+    bool live = false;                // a camera, frames cannot be replayed
+    cv::VideoCapture capture;
+    std::vector<std::string> files;   // image sequence, when not read through capture
+    size_t nextFile = 0;
+};
+
+bool openFrameSource(const std::string &spec, FrameSource &source);
+
+// Image files named by a directory or glob spec, in name order; empty for any other spec
+std::vector<std::string> listImages(const std::string &spec);
+
+// Next frame, false at the end of the stream
+bool readFrame(FrameSource &source, cv::Mat &frame);
+
+// Size of the frames, reading the first image of a sequence if needed
+cv::Size frameSourceSize(FrameSource &source);
+
+// Read a whole recorded stream into memory so replays measure processing, not decoding
+bool loadFrames(FrameSource &source, std::vector<cv::Mat> &frames, int maxFrames = 0);
+
+#endif
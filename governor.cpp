@@ -0,0 +1,153 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: quality/performance governor that trades detection and drawing detail for frame rate
+
+#include "governor.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include "metrics.h"
+
+// Best first. Level 0 keeps the tracker's own settings; each later level gives up a little
+// more accuracy: cheaper corner refinement, then flow tracking between searches, then a
+// downscaled search and a coarser scene.
+static const QualityLevel levels[] = {
+    {"full", cv::Size(), 0, 0, 0, 100},
+    {"subpix", cv::Size(7, 7), 30, 0, 0, 100},
+    {"track", cv::Size(7, 7), 30, 2, 0, 100},
+    {"scaled", cv::Size(5, 5), 20, 4, 640, 50},
+    {"minimal", cv::Size(5, 5), 10, 8, 480, 25},
+};
+
+
+void resetGovernor(Governor &governor) {
+    governor.level = 0;
+    governor.absent = false;
+    governor.startTime = -1;
+    governor.windowStart = 0;
+    governor.renderMs = governor.analyzeMs = 0;
+    governor.frames = 0;
+    governor.lowWindows = 0;
+    governor.lastSeen = 0;
+    governor.changes = 0;
+}
+
+
+int qualityLevelCount() {
+    return (int)(sizeof(levels) / sizeof(levels[0]));
+}
+
+
+const QualityLevel &qualityLevel(int level) {
+    return levels[std::min(std::max(level, 0), qualityLevelCount() - 1)];
+}
+
+
+static void logDecision(const Governor &governor, double time, const char *text) {
+    char line[logLineSize];
+    snprintf(line, sizeof(line), "Governor %.1f s: %s\n", time - governor.startTime, text);
+    logLine(line);
+}
+
+
+bool governFrame(Governor &governor, double time, bool found, double renderMs, double analyzeMs, int workers) {
+    if (governor.targetFps <= 0) {
+        return false;
+    }
+    if (governor.startTime < 0) {
+        governor.startTime = governor.windowStart = governor.lastSeen = time;
+    }
+    char text[logLineSize];
+
+    // Board absence switches the search, not the level
+    if (found) {
+        governor.lastSeen = time;
+        if (governor.absent) {
+            governor.absent = false;
+            governor.changes++;
+            logDecision(governor, time, "board found, searching every frame");
+        }
+    } else if (!governor.absent && time - governor.lastSeen > governor.absentAfter) {
+        governor.absent = true;
+        governor.changes++;
+        snprintf(text, sizeof(text), "no board for %.1f s, searching 1 frame in %d at %d px wide",
+                 time - governor.lastSeen, governor.absentInterval, governor.absentSearchWidth);
+        logDecision(governor, time, text);
+    }
+
+    governor.renderMs += renderMs;
+    governor.analyzeMs += analyzeMs;
+    governor.frames++;
+    if (time - governor.windowStart < governor.window) {
+        return false;
+    }
+
+    // Workers share the detection load; inline, detection and drawing add up on one thread
+    double budget = 1000.0 / governor.targetFps;
+    double render = governor.renderMs / governor.frames;
+    double analyze = governor.analyzeMs / governor.frames;
+    double load = (workers > 0 ? std::max(render, analyze / workers) : render + analyze) / budget;
+    governor.windowStart = time;
+    governor.renderMs = governor.analyzeMs = 0;
+    governor.frames = 0;
+
+    // Skipped searches make an absent board look cheap, so the level waits for it
+    if (governor.absent) {
+        governor.lowWindows = 0;
+        return false;
+    }
+
+    int level = governor.level;
+    int next = level;
+    if (load > governor.highLoad && level + 1 < qualityLevelCount()) {
+        next = level + 1;
+        governor.lowWindows = 0;
+    } else if (load < governor.lowLoad && level > 0) {
+        if (++governor.lowWindows >= governor.upWindows) {
+            next = level - 1;
+            governor.lowWindows = 0;
+        }
+    } else {
+        governor.lowWindows = 0;
+    }
+    if (next == level) {
+        return false;
+    }
+
+    governor.level = next;
+    governor.changes++;
+    snprintf(text, sizeof(text), "level %s -> %s, load %.2f of the %.1f ms budget (render %.1f ms, detect+pose %.1f ms on %d workers)",
+             qualityLevel(level).name, qualityLevel(next).name, load, budget, render, analyze, workers);
+    logDecision(governor, time, text);
+    return true;
+}
+
+
+bool skipSearch(const Governor &governor, uint64_t seq) {
+    return governor.targetFps > 0 && governor.absent && seq % governor.absentInterval != 0;
+}
+
+
+void applyQuality(const Governor &governor, const BoardTracker &base, BoardTracker &tracker, int &applied) {
+    bool absent = governor.absent;
+    int state = governor.level * 2 + (absent ? 1 : 0);
+    if (state == applied) {
+        return;
+    }
+    applied = state;
+
+    const QualityLevel &quality = qualityLevel(state / 2);
+    tracker.subPixWindow = quality.subPixWindow.area() > 0 ? quality.subPixWindow : base.subPixWindow;
+    tracker.subPixCriteria = base.subPixCriteria;
+    if (quality.subPixIterations > 0) {
+        tracker.subPixCriteria.maxCount = quality.subPixIterations;
+    }
+    tracker.trackFrames = std::max(base.trackFrames, quality.trackFrames);
+    int width = absent ? governor.absentSearchWidth : quality.searchWidth;
+    tracker.scaledSearch = base.scaledSearch || width > 0;
+    tracker.maxSearchWidth = width > 0 ? std::min(width, base.maxSearchWidth) : base.maxSearchWidth;
+}
+
+
+int levelLod(int level, int baseLod) {
+    return std::max(3, baseLod * qualityLevel(level).lodPercent / 100);
+}
@@ -0,0 +1,75 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: quality/performance governor that trades detection and drawing detail for frame rate
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "board_tracker.h"
+
+// Detection and drawing settings of one quality level
+struct QualityLevel {
+    const char *name;
+    cv::Size subPixWindow;
+    int subPixIterations;
+    int trackFrames;      // frames followed with optical flow between searches
+    int searchWidth;      // search a downscaled frame at most this wide first, 0 for full resolution
+    int lodPercent;       // share of the scene's level of detail
+};
+
+// Watches how much of the frame budget the render side and the detection workers use and
+// moves between quality levels to hold targetFps: one level cheaper as soon as a window runs
+// over highLoad, one level better after upWindows windows in a row under lowLoad. When no
+// board has been seen for absentAfter seconds, only one frame in absentInterval is searched,
+// on a downscaled frame, until the board is found again. Every change is logged.
+// The render side calls governFrame(); workers pick the settings up with applyQuality().
+struct Governor {
+    // Settings
+    double targetFps = 0;        // 0 turns the governor off
+    double window = 1.0;         // seconds per decision
+    double highLoad = 0.9;       // share of the frame budget
+    double lowLoad = 0.6;
+    int upWindows = 3;
+    double absentAfter = 2.0;    // seconds
+    int absentInterval = 4;
+    int absentSearchWidth = 480;
+
+    // Read by the workers
+    std::atomic<int> level{0};
+    std::atomic<bool> absent{false};
+
+    // Render-side state
+    double startTime = -1;
+    double windowStart = 0;
+    double renderMs = 0;
+    double analyzeMs = 0;
+    int frames = 0;
+    int lowWindows = 0;
+    double lastSeen = 0;
+    int changes = 0;
+};
+
+// Back to full quality with the board counted as seen, for a new run over a stream
+void resetGovernor(Governor &governor);
+
+int qualityLevelCount();
+const QualityLevel &qualityLevel(int level);
+
+// Account one displayed frame: found is whether it showed the board, renderMs the render
+// side's time on it and analyzeMs the detection and pose time its worker spent. Returns
+// true when the level changed.
+bool governFrame(Governor &governor, double time, bool found, double renderMs, double analyzeMs, int workers);
+
+// Whether a worker should skip searching frame seq, while the board is absent
+bool skipSearch(const Governor &governor, uint64_t seq);
+
+// Copy the current level's settings over base into a worker's tracker. applied holds the
+// state last applied, so the tracker is only touched when the level changes.
+void applyQuality(const Governor &governor, const BoardTracker &base, BoardTracker &tracker, int &applied);
+
+// Scene level of detail at a quality level
+int levelLod(int level, int baseLod);
+
+#endif
@@ -1,55 +1,223 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/utils/filesystem.hpp>
+#include "metrics.h"
+#include "frame_source.h"
+#include "simd_compat.h"
 
-int main() {
-    cv::VideoCapture cap(0); // Open the default camera
-    if (!cap.isOpened()) {
-        std::cerr << "Error: Unable to open the camera" << std::endl;
+// Harris detector settings
+struct HarrisParams {
+    int blockSize = 2;
+    int apertureSize = 3;
+    double k = 0.01;
+    float threshold = 100.0f / 255.0f;  // fraction of the response range a corner must exceed
+    int maxCorners = 0;                 // keep only the strongest N corners, 0 keeps all of them
+};
+
+
+// True if row[x] is above the threshold and the strict maximum of its 3x3 neighbourhood
+// (ties go to the first pixel in scan order, so a plateau yields one corner)
+static inline bool isPeak(const float *up, const float *row, const float *down, int x, float thresh) {
+    float c = row[x];
+    float before = std::max(std::max(up[x - 1], up[x]), std::max(up[x + 1], row[x - 1]));
+    float after = std::max(std::max(row[x + 1], down[x - 1]), std::max(down[x], down[x + 1]));
+    return c > thresh && c > before && c >= after;
+}
+
+
+// Threshold and 3x3 non-maximum suppression of the Harris response in one pass
+static void findPeaks(const cv::Mat &response, float thresh, std::vector<cv::KeyPoint> &corners) {
+    corners.clear();
+    for (int y = 1; y < response.rows - 1; ++y) {
+        const float *up = response.ptr<float>(y - 1);
+        const float *row = response.ptr<float>(y);
+        const float *down = response.ptr<float>(y + 1);
+        int x = 1;
+#if CV_SIMD || CV_SIMD_SCALABLE
+        // Compare a full vector of pixels against their neighbours at once; corners are
+        // sparse, so the lanes are only looked at one by one when a vector holds a peak
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        cv::v_float32 vthresh = cv::vx_setall_f32(thresh);
+        for (; x <= response.cols - 1 - lanes; x += lanes) {
+            cv::v_float32 c = cv::vx_load(row + x);
+            cv::v_float32 before = cv::v_max(cv::v_max(cv::vx_load(up + x - 1), cv::vx_load(up + x)),
+                                             cv::v_max(cv::vx_load(up + x + 1), cv::vx_load(row + x - 1)));
+            cv::v_float32 after = cv::v_max(cv::v_max(cv::vx_load(row + x + 1), cv::vx_load(down + x - 1)),
+                                            cv::v_max(cv::vx_load(down + x), cv::vx_load(down + x + 1)));
+            cv::v_float32 peak = cv::v_and(cv::v_and(cv::v_gt(c, vthresh), cv::v_gt(c, before)), cv::v_ge(c, after));
+            if (cv::v_check_any(peak)) {
+                for (int i = 0; i < lanes; ++i) {
+                    if (isPeak(up, row, down, x + i, thresh)) {
+                        corners.push_back(cv::KeyPoint(cv::Point2f((float)(x + i), (float)y), 5.0f, -1, row[x + i]));
+                    }
+                }
+            }
+        }
+#endif
+        for (; x < response.cols - 1; ++x) {
+            if (isPeak(up, row, down, x, thresh)) {
+                corners.push_back(cv::KeyPoint(cv::Point2f((float)x, (float)y), 5.0f, -1, row[x]));
+            }
+        }
+    }
+}
+
+
+// Harris corners of a grey image as a compact keypoint list; if capped, the strongest
+// maxCorners are kept, in no particular order
+void detectHarrisCorners(const cv::Mat &gray, const HarrisParams &params, cv::Mat &response, std::vector<cv::KeyPoint> &corners) {
+    cv::cornerHarris(gray, response, params.blockSize, params.apertureSize, params.k);
+
+    // Threshold relative to the response range, without normalising the whole image
+    double minVal, maxVal;
+    cv::minMaxLoc(response, &minVal, &maxVal);
+    float thresh = (float)(minVal + params.threshold * (maxVal - minVal));
+
+    findPeaks(response, thresh, corners);
+
+    if (params.maxCorners > 0 && (int)corners.size() > params.maxCorners) {
+        std::nth_element(corners.begin(), corners.begin() + params.maxCorners, corners.end(),
+                         [](const cv::KeyPoint &a, const cv::KeyPoint &b) { return a.response > b.response; });
+        corners.resize(params.maxCorners);
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+    HarrisParams params;
+    std::string metricsTarget;  // JSON-lines metrics destination: a file path or udp://host:port
+    std::string input = "0";    // Camera index, video file, image directory or glob
+    bool headless = false;      // No window: nothing is shown and no keys are read
+    std::string outputDir;      // Overlay frames and a per-frame corner log
+    int maxFrames = 0;          // Stop after this many frames, 0 runs to the end of the input
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            params.maxCorners = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            params.threshold = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metricsTarget = argv[++i];
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputDir = argv[++i];
+        } else if (strcmp(argv[i], "--max-frames") == 0 && i + 1 < argc) {
+            maxFrames = atoi(argv[++i]);
+        }
+    }
+
+    FrameSource source; // Open the camera, or the recorded video / image sequence
+    if (!openFrameSource(input, source)) {
+        std::cerr << "Error: Unable to open " << input << std::endl;
         return -1;
     }
 
-    cv::namedWindow("Harris Corners", 1);
-    
-    while (true) {
-        cv::Mat frame;
-        cap >> frame; // Capture frame from the camera
+    if (!headless) {
+        cv::namedWindow("Harris Corners", 1);
+    }
+
+    FILE *cornerLog = nullptr;
+    if (!outputDir.empty()) {
+        cv::utils::fs::createDirectories(outputDir);
+        cornerLog = fopen(cv::utils::fs::join(outputDir, "corners.csv").c_str(), "w");
+        if (cornerLog) {
+            fprintf(cornerLog, "frame,corners,harris_ms\n");
+        }
+    }
+
+    if (!metricsTarget.empty() && !startMetricsExport(metricsTarget, 1.0)) {
+        return -1;
+    }
+    StageHistogram *captureStage = metricStage("capture");
+    StageHistogram *grayStage = metricStage("gray");
+    StageHistogram *harrisStage = metricStage("harris");
+    StageHistogram *drawStage = metricStage("draw");
+    StageHistogram *displayStage = metricStage("display");
+
+    cv::Mat frame, gray, response;
+    std::vector<cv::KeyPoint> corners;
+    double totalMs = 0;
+    int frames = 0;
+
+    while (maxFrames <= 0 || frames < maxFrames) {
+        bool captured;
+        {
+            ScopedTimer timer(captureStage);
+            captured = readFrame(source, frame); // Capture the next frame
+        }
 
-        if (frame.empty()) {
-            std::cerr << "Error: Blank frame captured" << std::endl;
+        if (!captured) {
+            if (source.live) {
+                std::cerr << "Error: Blank frame captured" << std::endl;
+            }
             break;
         }
 
         // Convert the frame to grayscale
-        cv::Mat gray;
-        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+        {
+            ScopedTimer timer(grayStage);
+            cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+        }
 
         // Detect Harris corners
-        cv::Mat corners;
-        double threshold = 0.01;
-        cv::cornerHarris(gray, corners, 2, 3, threshold);
-
-        // Normalize the corner response
-        cv::normalize(corners, corners, 0, 255, cv::NORM_MINMAX, CV_32FC1, cv::Mat());
-
-        // Draw circles around the detected corners
-        for (int i = 0; i < corners.rows; ++i) {
-            for (int j = 0; j < corners.cols; ++j) {
-                if ((int)corners.at<float>(i, j) > 100) { // Adjust the threshold as needed
-                    cv::circle(frame, cv::Point(j, i), 5, cv::Scalar(230, 230, 100), 1.5);
-                }
+        int64 start = cv::getTickCount();
+        detectHarrisCorners(gray, params, response, corners);
+        double detectMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+        recordDuration(harrisStage, detectMs);
+        totalMs += detectMs;
+        frames++;
+
+        {
+            ScopedTimer timer(drawStage);
+
+            // One marker per corner
+            for (const cv::KeyPoint &corner : corners) {
+                cv::circle(frame, corner.pt, 5, cv::Scalar(230, 230, 100), 1);
             }
+
+            // Detector cost and corner count, for tuning
+            char text[64];
+            snprintf(text, sizeof(text), "harris %.1f ms, %d corners", detectMs, (int)corners.size());
+            cv::putText(frame, text, cv::Point(10, 25), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 255, 0), 2);
         }
 
-        cv::imshow("Harris Corners", frame);
+        if (!outputDir.empty()) {
+            char name[32];
+            snprintf(name, sizeof(name), "frame_%06d.png", frames - 1);
+            cv::imwrite(cv::utils::fs::join(outputDir, name), frame);
+            if (cornerLog) {
+                fprintf(cornerLog, "%d,%d,%.4f\n", frames - 1, (int)corners.size(), detectMs);
+            }
+        }
 
-        char key = cv::waitKey(10);
+        char key = 0;
+        if (!headless) {
+            ScopedTimer timer(displayStage);
+            cv::imshow("Harris Corners", frame);
+            key = cv::waitKey(1);
+        }
+        recordFrame();
         if (key == 'q') {
             break;
         }
     }
 
-    cap.release();
-    cv::destroyAllWindows();
+    stopMetricsExport();
+    if (cornerLog) {
+        fclose(cornerLog);
+    }
+    if (frames > 0) {
+        printf("Average detector time: %.2f ms over %d frames\n", totalMs / frames, frames);
+    }
+    printMetricsSummary();
+
+    if (!headless) {
+        cv::destroyAllWindows();
+    }
 
     return 0;
 }
-
@@ -1,18 +1,70 @@
 // Author: Hrigved Suryawanshi & Haard shah (1/19/24)
-// CODE: camera calibration on an image
+// CODE: camera calibration on an image, or on a whole directory of calibration images
 
 
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
 #include <iostream>
 #include <opencv2/opencv.hpp>
+#include "board_tracker.h"
+#include "calib_worker.h"
+#include "calib_store.h"
+#include "frame_source.h"
+#include "work_pool.h"
 
 using namespace cv;
 
-int main(int argc, char *argv[]) {
-    cv::Mat frame;
+// What the board search made of one calibration image
+struct ImageResult {
+    std::string filename;
+    cv::Size size;
+    std::vector<cv::Point2f> corners;
+    std::string rejected;   // why the image is not used, empty while it is
+};
 
-    // Define the path to the image
-    //std::string imagePath = "chess.JPEG";
-    std::string imagePath = "cal5.jpeg"; 
+// Batch settings
+struct BatchOptions {
+    cv::Size boardSize = cv::Size(6, 9);
+    int jobs = 0;                       // detection threads, 0 uses every core
+    double minBoardArea = 0.02;         // smallest board, as a fraction of the image area
+    double duplicateDistance = 0.02;    // views closer than this (viewDescriptor distance) are duplicates
+    double maxViewError = 3.0;          // drop views whose error exceeds this many times the median
+    int maxViews = 0;                   // solve over at most this many pose-diverse views, 0 uses all
+    std::string cameraId = "camera0";
+    std::string calibrationDir = "calibration";
+    std::string outputFile;             // overrides the calibration store path
+};
+
+
+// Shrink an image to fit the screen for display only, keeping its aspect ratio;
+// corners are always found at full resolution
+static cv::Mat fitToScreen(const cv::Mat &image, cv::Size screen) {
+    double scale = std::min(1.0, std::min((double)screen.width / image.cols, (double)screen.height / image.rows));
+    if (scale >= 1.0) {
+        return image;
+    }
+    cv::Mat shown;
+    cv::resize(image, shown, cv::Size(), scale, scale, cv::INTER_AREA);
+    return shown;
+}
+
+
+// World positions of the board corners, one unit per square, as vidcalib uses them
+static std::vector<cv::Vec3f> boardPoints(cv::Size boardSize) {
+    std::vector<cv::Vec3f> points;
+    for (int i = 0; i < boardSize.height; ++i) {
+        for (int j = 0; j < boardSize.width; ++j) {
+            points.push_back(cv::Vec3f(static_cast<float>(j), static_cast<float>(-i), 0.0f));
+        }
+    }
+    return points;
+}
+
+
+// Single image: find and show the corners
+static int showImageCorners(const std::string &imagePath, cv::Size boardSize) {
+    cv::Mat frame;
 
     // Load the image
     frame = cv::imread(imagePath);
@@ -26,18 +78,10 @@ int main(int argc, char *argv[]) {
     cv::Size refS(frame.cols, frame.rows);
     std::cout << "Image size: " << refS.width << " " << refS.height << std::endl;
 
-
-    // Resize the image to fit within the screen
-    cv::Size screenSize(1280, 820);  // Adjust the size according to your screen resolution
-    cv::resize(frame, frame, screenSize);
-
     Mat gray;
     // Convert the image to grayscale
     cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
 
-    // Define the chessboard size (rows x columns)
-    cv::Size boardSize(6, 9);
-
     // Find chessboard corners
     std::vector<cv::Point2f> framePoints;
     bool found = cv::findChessboardCorners(gray, boardSize, framePoints);
@@ -57,9 +101,253 @@ int main(int argc, char *argv[]) {
         std::cout << "Chessboard not found in the image.\n";
     }
 
-    // Display the image with detected corners
-    cv::imshow("Image", frame);
+    // Display the image with detected corners, scaled to fit the screen
+    cv::Size screenSize(1280, 820);  // Adjust the size according to your screen resolution
+    cv::imshow("Image", fitToScreen(frame, screenSize));
     cv::waitKey(0);
 
     return 0;
 }
+
+
+// Decode and search every image in parallel, one tracker per thread
+static void detectAll(std::vector<ImageResult> &results, const BatchOptions &options) {
+    int threads = options.jobs > 0 ? options.jobs : defaultThreadCount();
+    std::vector<BoardTracker> trackers(threads);
+    for (BoardTracker &tracker : trackers) {
+        tracker.boardSize = options.boardSize;
+        tracker.mode = DETECT_PYRAMID;   // stills are large: search a downscaled copy first
+    }
+
+    parallelForStealing((int)results.size(), threads, [&](int task, int thread) {
+        ImageResult &result = results[task];
+        cv::Mat gray = cv::imread(result.filename, cv::IMREAD_GRAYSCALE);
+        if (gray.empty()) {
+            result.rejected = "unreadable";
+            return;
+        }
+        result.size = gray.size();
+        if (!detectBoard(trackers[thread], gray, result.corners)) {
+            result.rejected = "no board";
+            return;
+        }
+        // Area of the outline through the four outer corners
+        const std::vector<cv::Point2f> &c = result.corners;
+        int w = options.boardSize.width;
+        std::vector<cv::Point2f> outline = {c.front(), c[w - 1], c.back(), c[c.size() - w]};
+        if (cv::contourArea(outline) < options.minBoardArea * gray.total()) {
+            result.rejected = "board too small";
+        }
+    });
+}
+
+
+// Calibrate a camera from every image in directories, globs or file lists
+static int calibrateBatch(const std::vector<std::string> &files, const BatchOptions &options) {
+    std::vector<ImageResult> results(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        results[i].filename = files[i];
+    }
+
+    int64 start = cv::getTickCount();
+    detectAll(results, options);
+    double detectSec = (cv::getTickCount() - start) / cv::getTickFrequency();
+    printf("Searched %d images in %.2f s (%.1f images/s)\n", (int)files.size(), detectSec, files.size() / std::max(detectSec, 1e-9));
+
+    // Every view has to come from the same resolution; the first usable image sets it
+    cv::Size imageSize;
+    for (const ImageResult &result : results) {
+        if (result.rejected.empty()) {
+            imageSize = result.size;
+            break;
+        }
+    }
+
+    // Drop views that add nothing: a different resolution, or the same board pose as an earlier view
+    std::vector<cv::Vec3f> points = boardPoints(options.boardSize);
+    std::vector<CalibrationView> views;
+    std::vector<int> viewImage;
+    std::vector<std::vector<double>> descriptors;
+    for (int i = 0; i < (int)results.size(); ++i) {
+        ImageResult &result = results[i];
+        if (!result.rejected.empty()) {
+            continue;
+        }
+        if (result.size != imageSize) {
+            result.rejected = "different resolution";
+            continue;
+        }
+        CalibrationView view;
+        view.corners = result.corners;
+        view.points = points;
+        std::vector<double> descriptor = viewDescriptor(view, imageSize);
+        for (size_t j = 0; j < descriptors.size() && result.rejected.empty(); ++j) {
+            double d = 0;
+            for (size_t k = 0; k < descriptor.size(); ++k) {
+                d += (descriptor[k] - descriptors[j][k]) * (descriptor[k] - descriptors[j][k]);
+            }
+            if (std::sqrt(d) < options.duplicateDistance) {
+                result.rejected = "duplicate of " + results[viewImage[j]].filename;
+            }
+        }
+        if (result.rejected.empty()) {
+            views.push_back(view);
+            viewImage.push_back(i);
+            descriptors.push_back(descriptor);
+        }
+    }
+
+    // Keep a pose-diverse subset when asked to
+    std::vector<int> used = selectDiverseViews(views, imageSize, options.maxViews);
+    std::vector<bool> keep(views.size(), false);
+    for (int i : used) {
+        keep[i] = true;
+    }
+    for (size_t i = 0; i < views.size(); ++i) {
+        if (!keep[i]) {
+            results[viewImage[i]].rejected = "not selected (--max-views)";
+        }
+    }
+
+    // One calibration, then once more without views that fit much worse than the rest
+    cv::Mat camera_matrix;
+    std::vector<double> distortion_coefficients;
+    double error = 0;
+    start = cv::getTickCount();
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<std::vector<cv::Vec3f>> point_list;
+        std::vector<std::vector<cv::Point2f>> corner_list;
+        for (int i : used) {
+            point_list.push_back(views[i].points);
+            corner_list.push_back(views[i].corners);
+        }
+        if (point_list.size() < 3) {
+            printf("Only %d usable views, at least 3 are needed\n", (int)point_list.size());
+            return -1;
+        }
+
+        std::vector<cv::Mat> rotations, translations;
+        cv::Mat deviationsIntrinsic, deviationsExtrinsic, viewErrors;
+        camera_matrix = cv::Mat::eye(3, 3, CV_64F);
+        distortion_coefficients.clear();
+        error = cv::calibrateCamera(point_list, corner_list, imageSize, camera_matrix, distortion_coefficients,
+                                    rotations, translations, deviationsIntrinsic, deviationsExtrinsic, viewErrors);
+        if (pass == 1) {
+            break;
+        }
+
+        std::vector<double> errors;
+        for (size_t k = 0; k < used.size(); ++k) {
+            errors.push_back(viewErrors.at<double>((int)k));
+        }
+        std::vector<double> sorted = errors;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        double limit = std::max(options.maxViewError * sorted[sorted.size() / 2], 0.5);
+        std::vector<int> inliers;
+        for (size_t k = 0; k < used.size(); ++k) {
+            if (errors[k] <= limit) {
+                inliers.push_back(used[k]);
+            }
+        }
+        if (inliers.size() == used.size() || inliers.size() < 3) {
+            break;
+        }
+
+        // Only views the second pass leaves out are reported as rejected
+        for (size_t k = 0; k < used.size(); ++k) {
+            if (errors[k] > limit) {
+                char reason[64];
+                snprintf(reason, sizeof(reason), "re-projection error %.2f px", errors[k]);
+                results[viewImage[used[k]]].rejected = reason;
+            }
+        }
+        used = inliers;
+    }
+    double calibrateSec = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+    // Report what was left out and why
+    int rejected = 0;
+    for (const ImageResult &result : results) {
+        if (!result.rejected.empty()) {
+            printf("  rejected %s: %s\n", result.filename.c_str(), result.rejected.c_str());
+            rejected++;
+        }
+    }
+    printf("Calibrated %dx%d from %d of %d images (%d rejected) in %.2f s, %.3f px RMS\n", imageSize.width, imageSize.height,
+           (int)used.size(), (int)results.size(), rejected, calibrateSec, error);
+    std::cout << "Camera Matrix:\n" << camera_matrix << "\n";
+    std::cout << "Distortion Coefficients:\n";
+    for (size_t i = 0; i < distortion_coefficients.size(); ++i) {
+        std::cout << distortion_coefficients[i] << " ";
+    }
+    std::cout << "\n";
+
+    // Store it where vidcalib looks for this camera and resolution
+    StoredCalibration stored;
+    stored.cameraId = options.cameraId;
+    stored.imageSize = imageSize;
+    stored.camera_matrix = camera_matrix;
+    stored.distortion_coefficients = distortion_coefficients;
+    stored.error = error;
+    for (int i : used) {
+        stored.views.push_back(views[i]);
+    }
+    std::string path = options.outputFile.empty() ? calibrationPath(options.calibrationDir, options.cameraId, imageSize) : options.outputFile;
+    if (!saveCalibration(path, stored)) {
+        printf("Unable to write %s\n", path.c_str());
+        return -1;
+    }
+    printf("Saved calibration to %s\n", path.c_str());
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    BatchOptions options;
+    std::vector<std::string> inputs;
+    bool batch = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            options.jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--camera-id") == 0 && i + 1 < argc) {
+            options.cameraId = argv[++i];
+        } else if (strcmp(argv[i], "--calib-dir") == 0 && i + 1 < argc) {
+            options.calibrationDir = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            options.outputFile = argv[++i];
+        } else if (strcmp(argv[i], "--max-views") == 0 && i + 1 < argc) {
+            options.maxViews = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-board-area") == 0 && i + 1 < argc) {
+            options.minBoardArea = atof(argv[++i]);
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    // Define the path to the image
+    //std::string imagePath = "chess.JPEG";
+    if (inputs.empty()) {
+        inputs.push_back("cal5.jpeg");
+    }
+
+    // Directories and globs expand to their images; plain file names are taken as they are
+    std::vector<std::string> files;
+    for (const std::string &input : inputs) {
+        std::vector<std::string> listed = listImages(input);
+        if (!listed.empty()) {
+            batch = true;
+            files.insert(files.end(), listed.begin(), listed.end());
+        } else {
+            files.push_back(input);
+        }
+    }
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    if (!batch && files.size() == 1) {
+        return showImageCorners(files[0], options.boardSize);
+    }
+    return calibrateBatch(files, options);
+}
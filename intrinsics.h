@@ -0,0 +1,36 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: camera intrinsics shared between the calibration and the frame workers
+
+#ifndef INTRINSICS_H
+#define INTRINSICS_H
+
+#include <memory>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// One immutable set of calibration results. Threads read the current set through
+// loadIntrinsics() and a new calibration publishes a fresh set with storeIntrinsics(),
+// so a frame is always processed with one consistent matrix and distortion vector.
+struct CameraIntrinsics {
+    cv::Mat camera_matrix;
+    std::vector<double> distortion_coefficients;
+};
+
+typedef std::shared_ptr<const CameraIntrinsics> IntrinsicsPtr;
+
+inline IntrinsicsPtr makeIntrinsics(const cv::Mat &camera_matrix, const std::vector<double> &distortion_coefficients) {
+    std::shared_ptr<CameraIntrinsics> intrinsics = std::make_shared<CameraIntrinsics>();
+    intrinsics->camera_matrix = camera_matrix.clone();
+    intrinsics->distortion_coefficients = distortion_coefficients;
+    return intrinsics;
+}
+
+inline IntrinsicsPtr loadIntrinsics(const IntrinsicsPtr &shared) {
+    return std::atomic_load(&shared);
+}
+
+inline void storeIntrinsics(IntrinsicsPtr &shared, IntrinsicsPtr intrinsics) {
+    std::atomic_store(&shared, std::move(intrinsics));
+}
+
+#endif
@@ -0,0 +1,290 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: mesh loading and caching for the objects drawn on the target
+
+#include "mesh.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// On-disk header of the binary mesh format, followed by
+// float[3 * numVertices], int32[numIndices], int32[numFaces + 1]
+struct MeshFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t numVertices;
+    uint32_t numIndices;
+    uint32_t numFaces;
+    uint32_t reserved;
+};
+
+static const char meshMagic[4] = {'M', 'E', 'S', 'H'};
+static const uint32_t meshVersion = 1;
+
+
+Mesh::~Mesh() {
+#ifndef _WIN32
+    if (mapAddr) {
+        munmap(mapAddr, mapSize);
+    }
+#endif
+}
+
+
+// Point the mesh views at the owned vectors
+static void bindOwnedData(Mesh &mesh) {
+    mesh.vertices = mesh.vertexData.data();
+    mesh.indices = mesh.indexData.data();
+    mesh.faceOffsets = mesh.offsetData.data();
+    mesh.numVertices = (int)mesh.vertexData.size();
+    mesh.numIndices = (int)mesh.indexData.size();
+    mesh.numFaces = (int)mesh.offsetData.size() - 1;
+}
+
+
+static bool indicesInRange(const Mesh &mesh) {
+    for (int i = 0; i < mesh.numIndices; ++i) {
+        if (mesh.indices[i] < 0 || mesh.indices[i] >= mesh.numVertices) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Faces must cover the index array in order: from 0, never backwards, ending at numIndices
+static bool faceOffsetsValid(const Mesh &mesh) {
+    if (mesh.faceOffsets[0] != 0 || mesh.faceOffsets[mesh.numFaces] != mesh.numIndices) {
+        return false;
+    }
+    for (int f = 0; f < mesh.numFaces; ++f) {
+        if (mesh.faceOffsets[f + 1] < mesh.faceOffsets[f]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool readObjFile(const std::string &filename, Mesh &mesh) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // Read the whole file at once and walk it in place instead of going through a stream per line
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    mesh.vertexData.clear();
+    mesh.indexData.clear();
+    mesh.offsetData.assign(1, 0);
+
+    const char *p = text.c_str();
+    while (*p) {
+        while (*p == ' ' || *p == '\t') {
+            ++p;
+        }
+
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            char *end;
+            float x = std::strtof(p + 1, &end);
+            float y = std::strtof(end, &end);
+            float z = std::strtof(end, &end);
+            mesh.vertexData.push_back(cv::Point3f(x, y, z));
+            p = end;
+        } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            ++p;
+            for (;;) {
+                while (*p == ' ' || *p == '\t') {
+                    ++p;
+                }
+                if (*p == '\0' || *p == '\n' || *p == '\r') {
+                    break;
+                }
+                char *end;
+                long idx = std::strtol(p, &end, 10);
+                if (end == p) {
+                    break;
+                }
+                // OBJ indices are 1-based, negative indices count back from the last vertex
+                int vertex = idx > 0 ? (int)idx - 1 : (int)mesh.vertexData.size() + (int)idx;
+                mesh.indexData.push_back(vertex);
+
+                // Skip texture and normal indices ("v/vt/vn")
+                p = end;
+                while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+                    ++p;
+                }
+            }
+            if ((int)mesh.indexData.size() > mesh.offsetData.back()) {
+                mesh.offsetData.push_back((int)mesh.indexData.size());
+            }
+        }
+
+        // Move on to the next line
+        while (*p && *p != '\n') {
+            ++p;
+        }
+        if (*p) {
+            ++p;
+        }
+    }
+
+    bindOwnedData(mesh);
+    if (!indicesInRange(mesh)) {
+        std::cerr << "Error: OBJ file " << filename << " has face indices out of range" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool writeMeshFile(const std::string &filename, const Mesh &mesh) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    MeshFileHeader header;
+    std::memcpy(header.magic, meshMagic, sizeof(meshMagic));
+    header.version = meshVersion;
+    header.numVertices = (uint32_t)mesh.numVertices;
+    header.numIndices = (uint32_t)mesh.numIndices;
+    header.numFaces = (uint32_t)mesh.numFaces;
+    header.reserved = 0;
+
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)mesh.vertices, sizeof(cv::Point3f) * mesh.numVertices);
+    file.write((const char *)mesh.indices, sizeof(int) * mesh.numIndices);
+    file.write((const char *)mesh.faceOffsets, sizeof(int) * (mesh.numFaces + 1));
+    return (bool)file;
+}
+
+
+// Check the header and that the file is large enough for the arrays it announces
+static bool validHeader(const MeshFileHeader &header, size_t fileSize) {
+    if (std::memcmp(header.magic, meshMagic, sizeof(meshMagic)) != 0 || header.version != meshVersion) {
+        return false;
+    }
+    if (header.numVertices > INT_MAX || header.numIndices > INT_MAX || header.numFaces >= INT_MAX) {
+        return false;
+    }
+    size_t expected = sizeof(MeshFileHeader) + sizeof(cv::Point3f) * (size_t)header.numVertices +
+                      sizeof(int) * ((size_t)header.numIndices + header.numFaces + 1);
+    return fileSize >= expected;
+}
+
+
+bool mapMeshFile(const std::string &filename, Mesh &mesh) {
+#ifdef _WIN32
+    // No mmap here, read the arrays into the owned vectors instead
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    size_t fileSize = (size_t)file.tellg();
+    file.seekg(0);
+
+    MeshFileHeader header;
+    if (fileSize < sizeof(header) || !file.read((char *)&header, sizeof(header)) || !validHeader(header, fileSize)) {
+        return false;
+    }
+    mesh.vertexData.resize(header.numVertices);
+    mesh.indexData.resize(header.numIndices);
+    mesh.offsetData.resize(header.numFaces + 1);
+    file.read((char *)mesh.vertexData.data(), sizeof(cv::Point3f) * header.numVertices);
+    file.read((char *)mesh.indexData.data(), sizeof(int) * header.numIndices);
+    file.read((char *)mesh.offsetData.data(), sizeof(int) * (header.numFaces + 1));
+    if (!file) {
+        return false;
+    }
+    bindOwnedData(mesh);
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MeshFileHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t fileSize = (size_t)st.st_size;
+    void *addr = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    const MeshFileHeader *header = (const MeshFileHeader *)addr;
+    if (!validHeader(*header, fileSize)) {
+        munmap(addr, fileSize);
+        return false;
+    }
+
+    const char *data = (const char *)addr + sizeof(MeshFileHeader);
+    mesh.mapAddr = addr;
+    mesh.mapSize = fileSize;
+    mesh.numVertices = (int)header->numVertices;
+    mesh.numIndices = (int)header->numIndices;
+    mesh.numFaces = (int)header->numFaces;
+    mesh.vertices = (const cv::Point3f *)data;
+    mesh.indices = (const int *)(data + sizeof(cv::Point3f) * mesh.numVertices);
+    mesh.faceOffsets = mesh.indices + mesh.numIndices;
+#endif
+
+    if (!indicesInRange(mesh)) {
+        std::cerr << "Error: mesh file " << filename << " has face indices out of range" << std::endl;
+        return false;
+    }
+    if (!faceOffsetsValid(mesh)) {
+        std::cerr << "Error: mesh file " << filename << " has corrupt face offsets" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+static std::mutex cacheMutex;
+static std::map<std::string, std::unique_ptr<Mesh>> meshCache;
+
+MeshHandle loadMesh(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto it = meshCache.find(filename);
+    if (it != meshCache.end()) {
+        return it->second.get();
+    }
+
+    std::unique_ptr<Mesh> mesh(new Mesh);
+    bool binary = filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".mesh") == 0;
+    bool loaded = binary ? mapMeshFile(filename, *mesh) : readObjFile(filename, *mesh);
+    if (!loaded) {
+        return nullptr;
+    }
+
+    MeshHandle handle = mesh.get();
+    meshCache[filename] = std::move(mesh);
+    return handle;
+}
+
+
+void clearMeshCache() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    meshCache.clear();
+}
@@ -0,0 +1,57 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: mesh loading and caching for the objects drawn on the target
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// A polygon mesh held in flat contiguous arrays.
+// Face i uses the vertex indices indices[faceOffsets[i]] .. indices[faceOffsets[i + 1] - 1].
+// The pointers either refer to the owned vectors (OBJ files) or into a memory-mapped
+// binary mesh file, so a mesh is never copied once it has been loaded.
+struct Mesh {
+    const cv::Point3f *vertices = nullptr;
+    const int *indices = nullptr;
+    const int *faceOffsets = nullptr;   // numFaces + 1 entries
+    int numVertices = 0;
+    int numIndices = 0;
+    int numFaces = 0;
+
+    // Backing storage when the mesh was parsed from an OBJ file
+    std::vector<cv::Point3f> vertexData;
+    std::vector<int> indexData;
+    std::vector<int> offsetData;
+
+    // Backing storage when the mesh was memory-mapped from a binary file
+    void *mapAddr = nullptr;
+    size_t mapSize = 0;
+
+    Mesh() = default;
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+    ~Mesh();
+};
+
+// Handle to a mesh owned by the mesh cache, valid until clearMeshCache() is called
+typedef const Mesh *MeshHandle;
+
+// Parse an OBJ file ("v" and "f" records only) into flat arrays
+bool readObjFile(const std::string &filename, Mesh &mesh);
+
+// Binary mesh format (.mesh): a fixed header followed by the vertex, index and
+// face offset arrays, laid out so the file can be mapped and used in place
+bool writeMeshFile(const std::string &filename, const Mesh &mesh);
+bool mapMeshFile(const std::string &filename, Mesh &mesh);
+
+// Load a mesh once and return the cached copy on every later call.
+// Files ending in ".mesh" are memory-mapped, anything else is parsed as OBJ.
+// Returns nullptr if the file could not be loaded.
+MeshHandle loadMesh(const std::string &filename);
+void clearMeshCache();
+
+#endif
@@ -0,0 +1,440 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: per-stage latency histograms, metrics export and a rate-limited console logger
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+static const int maxStages = 256;   // a few per stream in ar_server
+
+static std::mutex stageMutex;
+static std::unique_ptr<StageHistogram> stages[maxStages];
+static std::atomic<int> stageCount{0};
+static std::atomic<uint64_t> frameCount{0};
+static std::atomic<int64_t> startTicks{cv::getTickCount()};
+
+
+static double secondsSince(int64_t ticks) {
+    return (cv::getTickCount() - ticks) / cv::getTickFrequency();
+}
+
+
+StageHistogram *metricStage(const char *name) {
+    std::lock_guard<std::mutex> lock(stageMutex);
+    int n = stageCount.load();
+    for (int i = 0; i < n; ++i) {
+        if (stages[i]->name == name) {
+            return stages[i].get();
+        }
+    }
+    if (n == maxStages) {
+        // Out of slots: share the last one rather than fail on a timing call
+        return stages[n - 1].get();
+    }
+    stages[n].reset(new StageHistogram);
+    stages[n]->name = name;
+    stageCount.store(n + 1);
+    return stages[n].get();
+}
+
+
+static int bucketIndex(uint64_t us) {
+    if (us < 16) {
+        return (int)us;
+    }
+    int e = 4;
+    while ((us >> (e + 1)) != 0 && e < 31) {
+        ++e;
+    }
+    if (e > 30) {
+        return histogramBuckets - 1;
+    }
+    int sub = (int)((us >> (e - 3)) & 7);
+    return 16 + (e - 4) * 8 + sub;
+}
+
+
+// Middle of a bucket, in microseconds
+static double bucketValue(int bucket) {
+    if (bucket < 16) {
+        return bucket;
+    }
+    int e = (bucket - 16) / 8 + 4;
+    int sub = (bucket - 16) % 8;
+    double low = (double)((uint64_t)(8 + sub) << (e - 3));
+    double width = (double)((uint64_t)1 << (e - 3));
+    return low + width / 2;
+}
+
+
+void recordDuration(StageHistogram *stage, double ms) {
+    uint64_t us = ms > 0 ? (uint64_t)(ms * 1000.0 + 0.5) : 0;
+    stage->buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    stage->count.fetch_add(1, std::memory_order_relaxed);
+    stage->totalUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+
+void recordFrame() {
+    frameCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+double histogramPercentile(const uint64_t *buckets, uint64_t count, double p) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p / 100.0 * count + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < histogramBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return bucketValue(i) / 1000.0;
+        }
+    }
+    return bucketValue(histogramBuckets - 1) / 1000.0;
+}
+
+
+// Counts of one stage at some point in time
+struct StageSnapshot {
+    uint64_t buckets[histogramBuckets];
+    uint64_t count;
+    uint64_t totalUs;
+};
+
+static void takeSnapshot(const StageHistogram &stage, StageSnapshot &snapshot) {
+    for (int i = 0; i < histogramBuckets; ++i) {
+        snapshot.buckets[i] = stage.buckets[i].load(std::memory_order_relaxed);
+    }
+    snapshot.count = stage.count.load(std::memory_order_relaxed);
+    snapshot.totalUs = stage.totalUs.load(std::memory_order_relaxed);
+}
+
+
+double stagePercentile(const StageHistogram *stage, double p) {
+    StageSnapshot snapshot;
+    takeSnapshot(*stage, snapshot);
+    return histogramPercentile(snapshot.buckets, snapshot.count, p);
+}
+
+
+// Stage names carry stream ids from the command line or a config file, so they are escaped
+static void writeJsonString(std::ostream &out, const std::string &text) {
+    out << '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << (char)c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << (char)c;
+        }
+    }
+    out << '"';
+}
+
+
+static void writeStageJson(std::ostream &out, const std::string &name, const StageSnapshot &snapshot) {
+    writeJsonString(out, name);
+    out << ":{\"n\":" << snapshot.count
+        << ",\"mean_ms\":" << (snapshot.count ? snapshot.totalUs / 1000.0 / snapshot.count : 0.0)
+        << ",\"p50_ms\":" << histogramPercentile(snapshot.buckets, snapshot.count, 50)
+        << ",\"p95_ms\":" << histogramPercentile(snapshot.buckets, snapshot.count, 95)
+        << ",\"p99_ms\":" << histogramPercentile(snapshot.buckets, snapshot.count, 99) << "}";
+}
+
+
+void resetMetrics() {
+    int n = stageCount.load();
+    for (int i = 0; i < n; ++i) {
+        for (int b = 0; b < histogramBuckets; ++b) {
+            stages[i]->buckets[b].store(0, std::memory_order_relaxed);
+        }
+        stages[i]->count.store(0, std::memory_order_relaxed);
+        stages[i]->totalUs.store(0, std::memory_order_relaxed);
+    }
+    frameCount.store(0);
+    startTicks.store(cv::getTickCount());
+}
+
+
+std::string metricsJson() {
+    double elapsed = secondsSince(startTicks);
+    uint64_t frames = frameCount.load();
+
+    std::ostringstream out;
+    out.precision(4);
+    out << std::fixed << "{\"elapsed_s\":" << elapsed << ",\"frames\":" << frames
+        << ",\"fps\":" << (elapsed > 0 ? frames / elapsed : 0.0) << ",\"stages\":{";
+    StageSnapshot snapshot;
+    int n = stageCount.load();
+    for (int i = 0; i < n; ++i) {
+        takeSnapshot(*stages[i], snapshot);
+        out << (i ? "," : "");
+        writeStageJson(out, stages[i]->name, snapshot);
+    }
+    out << "}}";
+    return out.str();
+}
+
+
+// Metrics export
+
+struct MetricsExporter {
+    std::string target;
+    double interval = 1.0;
+    std::ofstream file;
+    int socketFd = -1;
+#ifndef _WIN32
+    sockaddr_in address;
+#endif
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+};
+
+static MetricsExporter exporter;
+
+
+static void sendLine(const std::string &line) {
+    if (exporter.file.is_open()) {
+        exporter.file << line << "\n";
+        exporter.file.flush();
+    }
+#ifndef _WIN32
+    if (exporter.socketFd >= 0) {
+        sendto(exporter.socketFd, line.data(), line.size(), 0, (const sockaddr *)&exporter.address, sizeof(exporter.address));
+    }
+#endif
+}
+
+
+static void exportLoop() {
+    std::vector<StageSnapshot> previous(maxStages);
+    for (StageSnapshot &snapshot : previous) {
+        snapshot = StageSnapshot();
+    }
+    StageSnapshot current, delta;
+    uint64_t previousFrames = frameCount.load();
+    int64_t previousTicks = cv::getTickCount();
+
+    while (!exporter.stopping) {
+        // Sleep in short steps so stopping does not wait a whole interval
+        int64_t wakeTicks = previousTicks + (int64_t)(exporter.interval * cv::getTickFrequency());
+        while (!exporter.stopping && cv::getTickCount() < wakeTicks) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+
+        int64_t nowTicks = cv::getTickCount();
+        double elapsed = (nowTicks - previousTicks) / cv::getTickFrequency();
+        uint64_t frames = frameCount.load();
+        previousFrames = std::min(previousFrames, frames);
+
+        std::ostringstream line;
+        line.precision(4);
+        line << std::fixed << "{\"t\":" << std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count()
+             << ",\"interval_s\":" << elapsed
+             << ",\"frames\":" << (frames - previousFrames)
+             << ",\"fps\":" << (elapsed > 0 ? (frames - previousFrames) / elapsed : 0.0)
+             << ",\"stages\":{";
+
+        int n = stageCount.load();
+        for (int i = 0; i < n; ++i) {
+            takeSnapshot(*stages[i], current);
+            if (current.count < previous[i].count) {
+                previous[i] = StageSnapshot();   // reset since the last line
+            }
+            for (int b = 0; b < histogramBuckets; ++b) {
+                delta.buckets[b] = current.buckets[b] - previous[i].buckets[b];
+            }
+            delta.count = current.count - previous[i].count;
+            delta.totalUs = current.totalUs - previous[i].totalUs;
+            previous[i] = current;
+
+            line << (i ? "," : "");
+            writeStageJson(line, stages[i]->name, delta);
+        }
+        line << "}}";
+        sendLine(line.str());
+
+        previousFrames = frames;
+        previousTicks = nowTicks;
+    }
+}
+
+
+bool startMetricsExport(const std::string &target, double intervalSec) {
+    exporter.target = target;
+    exporter.interval = intervalSec > 0 ? intervalSec : 1.0;
+
+    if (target.compare(0, 6, "udp://") == 0) {
+#ifdef _WIN32
+        std::cerr << "Error: UDP metrics export is not supported on this platform" << std::endl;
+        return false;
+#else
+        std::string hostPort = target.substr(6);
+        size_t colon = hostPort.rfind(':');
+        if (colon == std::string::npos) {
+            std::cerr << "Error: metrics target must be udp://host:port" << std::endl;
+            return false;
+        }
+        std::memset(&exporter.address, 0, sizeof(exporter.address));
+        exporter.address.sin_family = AF_INET;
+        exporter.address.sin_port = htons((uint16_t)atoi(hostPort.substr(colon + 1).c_str()));
+        if (inet_pton(AF_INET, hostPort.substr(0, colon).c_str(), &exporter.address.sin_addr) != 1) {
+            std::cerr << "Error: metrics host must be an IPv4 address" << std::endl;
+            return false;
+        }
+        exporter.socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (exporter.socketFd < 0) {
+            return false;
+        }
+#endif
+    } else {
+        exporter.file.open(target, std::ios::app);
+        if (!exporter.file.is_open()) {
+            std::cerr << "Error: Could not open metrics file " << target << std::endl;
+            return false;
+        }
+    }
+
+    exporter.stopping = false;
+    exporter.thread = std::thread(exportLoop);
+    return true;
+}
+
+
+void stopMetricsExport() {
+    exporter.stopping = true;
+    if (exporter.thread.joinable()) {
+        exporter.thread.join();
+    }
+    if (exporter.file.is_open()) {
+        exporter.file.close();
+    }
+#ifndef _WIN32
+    if (exporter.socketFd >= 0) {
+        close(exporter.socketFd);
+        exporter.socketFd = -1;
+    }
+#endif
+}
+
+
+void printMetricsSummary() {
+    double elapsed = secondsSince(startTicks);
+    uint64_t frames = frameCount.load();
+    printf("Frames: %llu in %.1f s (%.1f FPS)\n", (unsigned long long)frames, elapsed, elapsed > 0 ? frames / elapsed : 0.0);
+    printf("%-20s %8s %9s %9s %9s %9s\n", "stage", "count", "mean ms", "p50 ms", "p95 ms", "p99 ms");
+
+    StageSnapshot snapshot;
+    int n = stageCount.load();
+    for (int i = 0; i < n; ++i) {
+        takeSnapshot(*stages[i], snapshot);
+        printf("%-20s %8llu %9.3f %9.3f %9.3f %9.3f\n", stages[i]->name.c_str(), (unsigned long long)snapshot.count,
+               snapshot.count ? snapshot.totalUs / 1000.0 / snapshot.count : 0.0,
+               histogramPercentile(snapshot.buckets, snapshot.count, 50),
+               histogramPercentile(snapshot.buckets, snapshot.count, 95),
+               histogramPercentile(snapshot.buckets, snapshot.count, 99));
+    }
+}
+
+
+// Rate-limited asynchronous console logger
+
+struct LogMessage {
+    char text[logLineSize];
+};
+
+struct AsyncLogger {
+    RingQueue<LogMessage> queue{64};
+    std::atomic<int64_t> lastTicks[LOG_CHANNELS];
+    int64_t intervalTicks = 0;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<bool> stopping{false};
+};
+
+static AsyncLogger logger;
+
+
+static void logLoop() {
+    LogMessage message;
+    for (;;) {
+        if (logger.queue.tryPop(message)) {
+            fputs(message.text, stdout);
+        } else if (logger.stopping) {
+            break;
+        } else {
+            fflush(stdout);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    fflush(stdout);
+}
+
+
+void startLogger(double intervalSec) {
+    logger.intervalTicks = (int64_t)(intervalSec * cv::getTickFrequency());
+    for (int i = 0; i < LOG_CHANNELS; ++i) {
+        logger.lastTicks[i].store(INT64_MIN / 2);
+    }
+    logger.stopping = false;
+    logger.thread = std::thread(logLoop);
+    logger.running = true;
+}
+
+
+bool logReady(LogChannel channel) {
+    if (!logger.running) {
+        return true;
+    }
+    int64_t now = cv::getTickCount();
+    int64_t last = logger.lastTicks[channel].load(std::memory_order_relaxed);
+    if (now - last < logger.intervalTicks) {
+        return false;
+    }
+    // Only one thread wins the slot for this interval
+    return logger.lastTicks[channel].compare_exchange_strong(last, now, std::memory_order_relaxed);
+}
+
+
+void logLine(const char *text) {
+    if (!logger.running) {
+        fputs(text, stdout);
+        return;
+    }
+    // Never block the frame loop on the console; drop the line if the writer is behind
+    LogMessage message;
+    strncpy(message.text, text, logLineSize - 1);
+    message.text[logLineSize - 1] = '\0';
+    logger.queue.tryPush(message);
+}
+
+
+void stopLogger() {
+    if (!logger.running) {
+        return;
+    }
+    logger.stopping = true;
+    logger.thread.join();
+    logger.running = false;
+}
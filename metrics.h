@@ -0,0 +1,90 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: per-stage latency histograms, metrics export and a rate-limited console logger
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "ring_queue.h"
+
+// Log-linear latency histogram in microseconds: exact below 16 us, then 8 buckets per
+// power of two (about 6% resolution). Recording is a couple of relaxed atomic adds,
+// so any thread can record without locking.
+const int histogramBuckets = 16 + 27 * 8;
+
+struct StageHistogram {
+    std::string name;
+    std::atomic<uint64_t> buckets[histogramBuckets];
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> totalUs{0};
+
+    StageHistogram() {
+        for (int i = 0; i < histogramBuckets; ++i) {
+            buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+// Histogram of a named stage, created on first use. Look stages up once (e.g. into a
+// static local) and record through the pointer; the lookup itself takes a lock.
+StageHistogram *metricStage(const char *name);
+
+void recordDuration(StageHistogram *stage, double ms);
+
+// Count one finished frame for the frames-per-second figure
+void recordFrame();
+
+// Times the enclosing scope into a stage
+struct ScopedTimer {
+    StageHistogram *stage;
+    int64_t start;
+
+    explicit ScopedTimer(StageHistogram *stage) : stage(stage), start(cv::getTickCount()) {}
+    ~ScopedTimer() {
+        recordDuration(stage, (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency());
+    }
+};
+
+// p-th percentile (0-100) in milliseconds of a bucket snapshot
+double histogramPercentile(const uint64_t *buckets, uint64_t count, double p);
+
+// p-th percentile of a stage so far, in milliseconds
+double stagePercentile(const StageHistogram *stage, double p);
+
+// Periodically writes one JSON line per interval with the FPS and the p50/p95/p99 and mean
+// of every stage over that interval. target is a file path or "udp://host:port".
+bool startMetricsExport(const std::string &target, double intervalSec);
+void stopMetricsExport();
+
+// Print the percentiles of every stage over the whole run
+void printMetricsSummary();
+
+// Zero every stage and the frame count, e.g. after a benchmark warm-up
+void resetMetrics();
+
+// FPS and per-stage percentiles since the start (or the last reset) as one JSON object
+std::string metricsJson();
+
+// Console output moved off the frame path: producers check logReady() before formatting
+// anything, so each channel prints at most once per interval, and a writer thread does
+// the actual console writes. Lines are copied into fixed-size slots (longer ones are cut),
+// so logging never allocates.
+enum LogChannel {
+    LOG_POSE,
+    LOG_DETECT,
+    LOG_STATUS,
+    LOG_CHANNELS
+};
+
+const int logLineSize = 512;
+
+void startLogger(double intervalSec);
+bool logReady(LogChannel channel);
+void logLine(const char *text);
+void stopLogger();
+
+#endif
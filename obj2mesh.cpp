@@ -0,0 +1,26 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: convert an OBJ model to the binary mesh format loaded by vidcalib
+
+#include <iostream>
+#include "mesh.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: %s <input.obj> <output.mesh>\n", argv[0]);
+        return -1;
+    }
+
+    Mesh mesh;
+    if (!readObjFile(argv[1], mesh)) {
+        printf("Unable to read OBJ file: %s\n", argv[1]);
+        return -1;
+    }
+
+    if (!writeMeshFile(argv[2], mesh)) {
+        printf("Unable to write mesh file: %s\n", argv[2]);
+        return -1;
+    }
+
+    std::cout << "Vertices: " << mesh.numVertices << " Faces: " << mesh.numFaces << "\n";
+    return 0;
+}
@@ -0,0 +1,250 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: capture -> detect/pose -> render pipeline running each stage on its own threads
+
+#include "pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Back off while a queue is empty: spin briefly, then sleep
+static void idle(int &spins) {
+    if (++spins < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+
+double pipelineClock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void recyclePacket(Pipeline &pipeline, FramePacket &packet) {
+    // Inline, the caller's packet already keeps its buffers
+    if (pipeline.workers > 0) {
+        pipeline.recycled.tryPush(packet);
+    }
+}
+
+
+void skipPacket(Pipeline &pipeline, FramePacket &packet) {
+    pipeline.framesShown--;
+    pipeline.framesLate++;
+    recyclePacket(pipeline, packet);
+}
+
+
+// A packet from the ring, with the previous frame's results cleared but its buffers kept
+static void takePacket(Pipeline &pipeline, FramePacket &packet) {
+    if (pipeline.workers > 0) {
+        pipeline.recycled.tryPop(packet);
+    }
+    packet.found = false;
+    packet.corners.clear();
+    packet.reprojectionError = 0;
+    packet.fullSolve = false;
+    packet.source = FOUND_NONE;
+    packet.targetsFound = packet.targetsFused = 0;
+    packet.detectMs = 0;
+    packet.poseMs = 0;
+}
+
+
+// Queue a packet, dropping the oldest one or waiting for room depending on the pipeline.
+// Returns the number of packets dropped.
+static int pushPacket(Pipeline &pipeline, RingQueue<FramePacket> &queue, FramePacket &packet) {
+    if (pipeline.dropFrames) {
+        // Dropped packets go back to the ring rather than being freed
+        int dropped = 0;
+        FramePacket oldest;
+        while (!queue.tryPush(packet)) {
+            std::unique_lock<std::mutex> lock(pipeline.flightMutex);
+            bool popped = queue.tryPop(oldest);
+            lock.unlock();
+            if (popped) {
+                recyclePacket(pipeline, oldest);
+                dropped++;
+            }
+        }
+        return dropped;
+    }
+    int spins = 0;
+    while (!queue.tryPush(packet)) {
+        if (pipeline.stopping) {
+            return 1;
+        }
+        idle(spins);
+    }
+    return 0;
+}
+
+
+static void captureLoop(Pipeline &pipeline) {
+    uint64_t seq = 0;
+    while (!pipeline.stopping) {
+        FramePacket packet;
+        takePacket(pipeline, packet);
+        if (!pipeline.capture(packet.frame) || packet.frame.empty()) {
+            break;
+        }
+        packet.captureTime = pipelineClock();
+        packet.seq = seq++;
+        pipeline.framesCaptured++;
+        if (pipeline.keepLatest) {
+            // Our own buffer, it circulates with the render side's late frames
+            std::lock_guard<std::mutex> lock(pipeline.latestMutex);
+            packet.frame.copyTo(pipeline.latest);
+            pipeline.latestTime = packet.captureTime;
+            pipeline.latestSeq = packet.seq;
+            pipeline.latestFresh = true;
+        }
+        pipeline.droppedCaptured += pushPacket(pipeline, pipeline.captured, packet);
+    }
+    pipeline.captureDone = true;
+}
+
+
+static void workerLoop(Pipeline &pipeline, int worker) {
+    FramePacket packet;
+    int spins = 0;
+    while (!pipeline.stopping) {
+        bool popped;
+        {
+            std::lock_guard<std::mutex> lock(pipeline.flightMutex);
+            popped = pipeline.captured.tryPop(packet);
+            if (popped) {
+                pipeline.analyzing[worker] = packet.seq + 1;
+            }
+        }
+        if (popped) {
+            spins = 0;
+            pipeline.analyze(worker, packet);
+            pipeline.droppedAnalyzed += pushPacket(pipeline, pipeline.analyzed, packet);
+            std::lock_guard<std::mutex> lock(pipeline.flightMutex);
+            pipeline.analyzing[worker] = 0;
+        } else if (pipeline.captureDone && pipeline.captured.empty()) {
+            break;
+        } else {
+            idle(spins);
+        }
+    }
+    pipeline.runningWorkers--;
+}
+
+
+void startPipeline(Pipeline &pipeline) {
+    if (pipeline.workers == 0) {
+        return;
+    }
+    pipeline.runningWorkers = pipeline.workers;
+    pipeline.analyzing.assign(pipeline.workers, 0);
+    // Every packet in flight can end up waiting here at once
+    pipeline.pending.reserve(4 * pipeline.workers + 8);
+    pipeline.threads.emplace_back(captureLoop, std::ref(pipeline));
+    for (int i = 0; i < pipeline.workers; ++i) {
+        pipeline.threads.emplace_back(workerLoop, std::ref(pipeline), i);
+    }
+}
+
+
+// Whether a worker is still analyzing a frame in [first, last). Called once frame last has
+// arrived, so every earlier frame has left the captured queue: one that is not being analyzed
+// either reached the analyzed queue or was dropped.
+static bool inFlight(Pipeline &pipeline, uint64_t first, uint64_t last) {
+    std::lock_guard<std::mutex> lock(pipeline.flightMutex);
+    for (uint64_t seq : pipeline.analyzing) {
+        if (seq > first && seq <= last) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool nextPacket(Pipeline &pipeline, FramePacket &packet) {
+    if (pipeline.workers == 0) {
+        // The caller's packet is the only one, its buffers are reused in place
+        takePacket(pipeline, packet);
+        if (pipeline.stopping || !pipeline.capture(packet.frame) || packet.frame.empty()) {
+            return false;
+        }
+        packet.captureTime = pipelineClock();
+        packet.seq = pipeline.nextSeq++;
+        pipeline.framesCaptured++;
+        pipeline.analyze(0, packet);
+        pipeline.framesShown++;
+        return true;
+    }
+
+    int spins = 0;
+    FramePacket incoming;
+    while (!pipeline.stopping) {
+        while (pipeline.analyzed.tryPop(incoming)) {
+            if (incoming.seq < pipeline.nextSeq) {
+                // A later frame is already on screen
+                pipeline.framesLate++;
+                recyclePacket(pipeline, incoming);
+                continue;
+            }
+            pipeline.pending.push_back(std::move(incoming));
+        }
+
+        if (!pipeline.pending.empty()) {
+            auto oldest = std::min_element(pipeline.pending.begin(), pipeline.pending.end(),
+                                           [](const FramePacket &a, const FramePacket &b) { return a.seq < b.seq; });
+            // Deliver the next frame in order. A missing frame no worker is analyzing was dropped
+            // and is skipped; should pending fill up behind a slow frame, that one is given up on too
+            bool finished = pipeline.runningWorkers == 0;
+            bool skipGap = false;
+            if (oldest->seq != pipeline.nextSeq && !finished) {
+                if (pipeline.pending.size() >= pipeline.pending.capacity()) {
+                    skipGap = true;
+                } else if (!inFlight(pipeline, pipeline.nextSeq, oldest->seq)) {
+                    // A worker queues its frame before it stops counting as in flight
+                    if (!pipeline.analyzed.empty()) {
+                        continue;
+                    }
+                    skipGap = true;
+                }
+            }
+            if (oldest->seq == pipeline.nextSeq || skipGap || finished) {
+                packet = std::move(*oldest);
+                pipeline.pending.erase(oldest);
+                pipeline.nextSeq = packet.seq + 1;
+                pipeline.framesShown++;
+                return true;
+            }
+        } else if (pipeline.runningWorkers == 0 && pipeline.analyzed.empty()) {
+            return false;
+        }
+        idle(spins);
+    }
+    return false;
+}
+
+
+bool takeLatestFrame(Pipeline &pipeline, uint64_t afterSeq, cv::Mat &frame, double &captureTime, uint64_t &seq) {
+    if (!pipeline.keepLatest || pipeline.workers == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(pipeline.latestMutex);
+    if (!pipeline.latestFresh || pipeline.latestSeq <= afterSeq) {
+        return false;
+    }
+    std::swap(frame, pipeline.latest);
+    captureTime = pipeline.latestTime;
+    seq = pipeline.latestSeq;
+    pipeline.latestFresh = false;
+    return true;
+}
+
+
+void stopPipeline(Pipeline &pipeline) {
+    pipeline.stopping = true;
+    for (std::thread &thread : pipeline.threads) {
+        thread.join();
+    }
+    pipeline.threads.clear();
+}
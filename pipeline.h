@@ -0,0 +1,117 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: capture -> detect/pose -> render pipeline running each stage on its own threads
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "board_tracker.h"
+#include "intrinsics.h"
+#include "ring_queue.h"
+
+// One captured frame and what the detection/pose stage found in it
+struct FramePacket {
+    uint64_t seq = 0;
+    double captureTime = 0;     // seconds on pipelineClock() when the frame was grabbed
+    cv::Mat frame;
+    cv::Mat spare;              // second image buffer, e.g. for the undistorted frame
+
+    IntrinsicsPtr intrinsics;   // calibration the pose was computed with
+    IntrinsicsPtr drawIntrinsics;   // calibration to draw with: the pinhole model of an undistorted frame
+    bool found = false;
+    std::vector<cv::Point2f> corners;
+    cv::Mat rvec, tvec;
+    double reprojectionError = 0;   // RMS in pixels
+    bool fullSolve = false;         // pose solved from scratch rather than tracked
+    DetectSource source = FOUND_NONE;
+    int targetsFound = 0;           // with a target set: targets seen and fused into the pose
+    int targetsFused = 0;
+    double detectMs = 0;
+    double poseMs = 0;
+};
+
+// Grab the next frame, false at the end of the stream
+typedef std::function<bool(cv::Mat &frame)> CaptureStage;
+// Detection and pose for one frame; worker is the index of the calling worker thread
+typedef std::function<void(int worker, FramePacket &packet)> AnalyzeStage;
+
+// A capture thread feeds a pool of analyze workers through a bounded queue, and the
+// render/display side (the thread calling nextPacket) receives the results in frame order.
+// Both queues drop their oldest entry when full, so a slow stage costs frames, not latency;
+// with dropFrames off (recorded input) a full queue blocks instead and every frame is shown.
+// With workers == 0 every stage runs inline on the calling thread.
+// Packets go round in a ring: the render side hands each one back with recyclePacket()
+// and the capture side reuses its image buffers and vectors, so once every packet has been
+// round once the loop stops allocating.
+struct Pipeline {
+    explicit Pipeline(int workers)
+        : workers(workers), captured(2), analyzed(2 * workers + 2), recycled(4 * workers + 8) {}
+
+    CaptureStage capture;
+    AnalyzeStage analyze;
+    int workers;
+    bool dropFrames = true;
+
+    RingQueue<FramePacket> captured;   // capture -> workers
+    RingQueue<FramePacket> analyzed;   // workers -> render
+    RingQueue<FramePacket> recycled;   // render -> capture, packets with their buffers
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> captureDone{false};
+    std::atomic<int> runningWorkers{0};
+
+    // With keepLatest the capture thread also copies every frame into this slot, so the render
+    // side can draw a result onto a frame grabbed after the one it was computed from
+    bool keepLatest = false;
+    std::mutex latestMutex;
+    cv::Mat latest;
+    double latestTime = 0;
+    uint64_t latestSeq = 0;
+    bool latestFresh = false;   // not yet taken
+
+    // Results waiting for an earlier frame, owned by the render side
+    std::vector<FramePacket> pending;
+    uint64_t nextSeq = 0;
+
+    // The frame each worker is analyzing (seq + 1, 0 when idle), so the render side can tell a
+    // frame still being worked on from one that was dropped. Frames leave the captured queue
+    // only under flightMutex, so they leave it in order.
+    std::mutex flightMutex;
+    std::vector<uint64_t> analyzing;
+
+    // Statistics
+    std::atomic<uint64_t> framesCaptured{0};
+    std::atomic<uint64_t> droppedCaptured{0};
+    std::atomic<uint64_t> droppedAnalyzed{0};
+    uint64_t framesLate = 0;
+    uint64_t framesShown = 0;
+};
+
+// Monotonic clock in seconds used for frame timestamps
+double pipelineClock();
+
+void startPipeline(Pipeline &pipeline);
+
+// Wait for the next result in frame order. Returns false once the stream has ended
+// and every result has been delivered, or after stopPipeline().
+bool nextPacket(Pipeline &pipeline, FramePacket &packet);
+
+// Return a packet the render side is done with so its buffers are reused
+void recyclePacket(Pipeline &pipeline, FramePacket &packet);
+
+// Hand back a packet nextPacket delivered but the render side did not show; it counts as late
+void skipPacket(Pipeline &pipeline, FramePacket &packet);
+
+// Take the newest captured frame if it is later than frame afterSeq. The frame is swapped with
+// the caller's buffer, which the capture side then reuses. Only with keepLatest and workers.
+bool takeLatestFrame(Pipeline &pipeline, uint64_t afterSeq, cv::Mat &frame, double &captureTime, uint64_t &seq);
+
+void stopPipeline(Pipeline &pipeline);
+
+#endif
@@ -0,0 +1,164 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: board pose tracking from frame to frame and temporal smoothing of the pose
+
+#include "pose_tracker.h"
+#include "alloc_counter.h"
+#include "camera_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+double reprojectionRms(const std::vector<cv::Vec3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints,
+                       const cv::Mat &rvec, const cv::Mat &tvec, const cv::Mat &camera_matrix,
+                       const std::vector<double> &dist_coeff, std::vector<cv::Point2f> &reprojected) {
+    if (imagePoints.empty()) {
+        return 0;
+    }
+    projectFast(reinterpret_cast<const cv::Point3f *>(objectPoints.data()), (int)objectPoints.size(), rvec, tvec,
+                camera_matrix, dist_coeff, reprojected);
+    double sum = 0;
+    for (size_t i = 0; i < imagePoints.size(); ++i) {
+        cv::Point2f d = reprojected[i] - imagePoints[i];
+        sum += d.x * d.x + d.y * d.y;
+    }
+    return std::sqrt(sum / imagePoints.size());
+}
+
+
+bool estimatePose(PoseTracker &tracker, const std::vector<cv::Vec3f> &objectPoints,
+                  const std::vector<cv::Point2f> &imagePoints, const cv::Mat &camera_matrix,
+                  const std::vector<double> &dist_coeff, cv::Mat &rvec, cv::Mat &tvec) {
+    int64_t start = cv::getTickCount();
+    bool solved = false;
+    tracker.fullSolve = false;
+
+    // Start from last frame's pose, the board barely moves between frames
+    if (tracker.valid) {
+        tracker.rvec.copyTo(rvec);
+        tracker.tvec.copyTo(tvec);
+        if (tracker.refineOnly) {
+            LibraryScope library;
+            cv::solvePnPRefineLM(objectPoints, imagePoints, camera_matrix, dist_coeff, rvec, tvec);
+            solved = true;
+        } else {
+            LibraryScope library;
+            solved = cv::solvePnP(objectPoints, imagePoints, camera_matrix, dist_coeff, rvec, tvec, true);
+        }
+        if (solved) {
+            tracker.rms = reprojectionRms(objectPoints, imagePoints, rvec, tvec, camera_matrix, dist_coeff, tracker.reprojected);
+            solved = tracker.rms <= tracker.maxRms;
+        }
+    }
+
+    // Full solve when there is no usable previous pose; IPPE is made for planar targets
+    if (!solved) {
+        tracker.fullSolve = true;
+        {
+            LibraryScope library;
+            solved = cv::solvePnP(objectPoints, imagePoints, camera_matrix, dist_coeff, rvec, tvec, false, cv::SOLVEPNP_IPPE);
+        }
+        if (solved) {
+            tracker.rms = reprojectionRms(objectPoints, imagePoints, rvec, tvec, camera_matrix, dist_coeff, tracker.reprojected);
+        }
+    }
+
+    tracker.valid = solved;
+    if (solved) {
+        rvec.copyTo(tracker.rvec);
+        tvec.copyTo(tracker.tvec);
+        if (tracker.fullSolve) {
+            tracker.fullSolves++;
+        } else {
+            tracker.trackedSolves++;
+        }
+    }
+    tracker.poseMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+    return solved;
+}
+
+
+void resetPose(PoseTracker &tracker) {
+    tracker.valid = false;
+}
+
+
+bool parsePoseFilter(const std::string &name, PoseFilter &filter) {
+    if (name == "oneeuro") {
+        filter.enabled = true;
+    } else if (name == "none") {
+        filter.enabled = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// Smoothing factor of an exponential filter with the given cutoff frequency
+static double smoothingFactor(double cutoff, double dt) {
+    double tau = 1.0 / (2 * CV_PI * cutoff);
+    return 1.0 / (1.0 + tau / dt);
+}
+
+
+void filterPose(PoseFilter &filter, double timestamp, cv::Mat &rvec, cv::Mat &tvec) {
+    double x[6];
+    for (int i = 0; i < 3; ++i) {
+        x[i] = rvec.at<double>(i);
+        x[i + 3] = tvec.at<double>(i);
+    }
+
+    double dt = timestamp - filter.lastTime;
+    bool restart = !filter.initialized || dt <= 0;
+    for (int i = 0; i < 3 && !restart; ++i) {
+        restart = std::fabs(x[i] - filter.value[i]) > filter.maxJump;
+    }
+
+    if (restart) {
+        for (int i = 0; i < 6; ++i) {
+            filter.value[i] = x[i];
+            filter.velocity[i] = 0;
+        }
+        filter.initialized = true;
+        filter.lastTime = timestamp;
+        return;
+    }
+
+    double aVelocity = smoothingFactor(filter.dCutoff, dt);
+    for (int i = 0; i < 6; ++i) {
+        double v = (x[i] - filter.value[i]) / dt;
+        filter.velocity[i] += aVelocity * (v - filter.velocity[i]);
+        double cutoff = filter.minCutoff + filter.beta * std::fabs(filter.velocity[i]);
+        double a = smoothingFactor(cutoff, dt);
+        filter.value[i] += a * (x[i] - filter.value[i]);
+    }
+    filter.lastTime = timestamp;
+
+    if (!filter.enabled) {
+        return;
+    }
+    for (int i = 0; i < 3; ++i) {
+        rvec.at<double>(i) = filter.value[i];
+        tvec.at<double>(i) = filter.value[i + 3];
+    }
+}
+
+
+void resetPoseFilter(PoseFilter &filter) {
+    filter.initialized = false;
+}
+
+
+double predictPose(const PoseFilter &filter, double timestamp, cv::Mat &rvec, cv::Mat &tvec) {
+    if (!filter.initialized) {
+        return 0;
+    }
+    // Linear in the rotation vector, close enough to a constant angular velocity over a few frames
+    double dt = std::min(std::max(timestamp - filter.lastTime, 0.0), filter.maxPredict);
+    for (int i = 0; i < 3; ++i) {
+        rvec.at<double>(i) += filter.velocity[i] * dt;
+        tvec.at<double>(i) += filter.velocity[i + 3] * dt;
+    }
+    return dt;
+}
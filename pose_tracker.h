@@ -0,0 +1,71 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: board pose tracking from frame to frame and temporal smoothing of the pose
+
+#ifndef POSE_TRACKER_H
+#define POSE_TRACKER_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Pose solving for one detection worker. While the board stays in view each frame
+// starts from the previous pose and only runs a full solve when the tracked pose
+// reprojects badly.
+struct PoseTracker {
+    // Settings
+    bool refineOnly = true;   // Levenberg-Marquardt refinement of the last pose instead of solvePnP with a guess
+    double maxRms = 2.0;      // pixels; above this the tracked pose is dropped and solved from scratch
+
+    // State
+    bool valid = false;
+    cv::Mat rvec, tvec;
+    std::vector<cv::Point2f> reprojected;   // scratch for the error computation
+
+    // Result of the last call
+    bool fullSolve = false;
+    double rms = 0;
+    double poseMs = 0;
+    int fullSolves = 0;
+    int trackedSolves = 0;
+};
+
+// Estimate the board pose; rvec and tvec receive the result and tracker.rms its reprojection RMS
+bool estimatePose(PoseTracker &tracker, const std::vector<cv::Vec3f> &objectPoints,
+                  const std::vector<cv::Point2f> &imagePoints, const cv::Mat &camera_matrix,
+                  const std::vector<double> &dist_coeff, cv::Mat &rvec, cv::Mat &tvec);
+
+// Forget the last pose, e.g. when the board is lost
+void resetPose(PoseTracker &tracker);
+
+// Root mean square distance in pixels between the image points and the reprojected object points
+double reprojectionRms(const std::vector<cv::Vec3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints,
+                       const cv::Mat &rvec, const cv::Mat &tvec, const cv::Mat &camera_matrix,
+                       const std::vector<double> &dist_coeff, std::vector<cv::Point2f> &reprojected);
+
+// One-euro filter over the six pose parameters (rvec, tvec). Smooths jitter while the board
+// is still and follows quickly when it moves. Runs in frame order on the display side.
+struct PoseFilter {
+    bool enabled = true;
+    double minCutoff = 1.0;   // Hz, smoothing when the board is still
+    double beta = 0.5;        // how fast the cutoff rises with speed
+    double dCutoff = 1.0;     // Hz, smoothing of the speed estimate
+    double maxJump = 0.5;     // a rotation change above this (radians) restarts the filter
+    double maxPredict = 0.1;  // seconds a pose is extrapolated ahead at most
+
+    bool initialized = false;
+    double lastTime = 0;
+    double value[6];
+    double velocity[6];       // per second, also used to extrapolate the pose
+};
+
+bool parsePoseFilter(const std::string &name, PoseFilter &filter);
+
+// Filter a new measurement taken at timestamp (seconds) in place
+void filterPose(PoseFilter &filter, double timestamp, cv::Mat &rvec, cv::Mat &tvec);
+void resetPoseFilter(PoseFilter &filter);
+
+// Carry the last filtered pose forward to timestamp with the filter's velocity, for drawing onto
+// a frame grabbed after the one the pose was measured on. Returns the seconds predicted ahead.
+double predictPose(const PoseFilter &filter, double timestamp, cv::Mat &rvec, cv::Mat &tvec);
+
+#endif
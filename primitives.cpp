@@ -0,0 +1,119 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: parametric shapes (spheres, ellipsoids, prisms, cylinders) with edge and triangle topology
+
+#include "primitives.h"
+
+#include <algorithm>
+
+static void addEdge(Primitive &prim, int a, int b) {
+    prim.edges.push_back(a);
+    prim.edges.push_back(b);
+}
+
+static void addTriangle(Primitive &prim, int a, int b, int c) {
+    prim.triangles.push_back(a);
+    prim.triangles.push_back(b);
+    prim.triangles.push_back(c);
+}
+
+
+Primitive makeEllipsoid(const cv::Point3f &center, const cv::Point3f &radii, int slices, int stacks) {
+    slices = std::max(slices, 3);
+    stacks = std::max(stacks, 2);
+
+    Primitive prim;
+    prim.vertices.reserve(slices * (stacks - 1) + 2);
+
+    // North pole, then stacks - 1 rings of slices vertices, then the south pole
+    prim.vertices.push_back(cv::Point3f(center.x, center.y, center.z + radii.z));
+    for (int k = 1; k < stacks; ++k) {
+        double theta = CV_PI * k / stacks;
+        for (int j = 0; j < slices; ++j) {
+            double phi = 2 * CV_PI * j / slices;
+            prim.vertices.push_back(cv::Point3f(center.x + radii.x * (float)(sin(theta) * cos(phi)),
+                                                center.y + radii.y * (float)(sin(theta) * sin(phi)),
+                                                center.z + radii.z * (float)cos(theta)));
+        }
+    }
+    prim.vertices.push_back(cv::Point3f(center.x, center.y, center.z - radii.z));
+
+    int north = 0;
+    int south = (int)prim.vertices.size() - 1;
+    auto ring = [slices](int k, int j) { return 1 + k * slices + (j % slices); };
+    int rings = stacks - 1;
+
+    for (int j = 0; j < slices; ++j) {
+        // Meridians from pole to pole
+        addEdge(prim, north, ring(0, j));
+        for (int k = 0; k + 1 < rings; ++k) {
+            addEdge(prim, ring(k, j), ring(k + 1, j));
+        }
+        addEdge(prim, ring(rings - 1, j), south);
+
+        // Parallels
+        for (int k = 0; k < rings; ++k) {
+            addEdge(prim, ring(k, j), ring(k, j + 1));
+        }
+
+        // Caps and the quads between neighbouring rings
+        addTriangle(prim, north, ring(0, j), ring(0, j + 1));
+        for (int k = 0; k + 1 < rings; ++k) {
+            addTriangle(prim, ring(k, j), ring(k + 1, j), ring(k + 1, j + 1));
+            addTriangle(prim, ring(k, j), ring(k + 1, j + 1), ring(k, j + 1));
+        }
+        addTriangle(prim, ring(rings - 1, j), south, ring(rings - 1, j + 1));
+    }
+
+    return prim;
+}
+
+
+Primitive makeSphere(const cv::Point3f &center, float radius, int slices, int stacks) {
+    return makeEllipsoid(center, cv::Point3f(radius, radius, radius), slices, stacks);
+}
+
+
+Primitive makeCylinder(const cv::Point3f &base, float radius, float height, int slices, int stacks,
+                       float startAngle) {
+    slices = std::max(slices, 3);
+    stacks = std::max(stacks, 1);
+
+    Primitive prim;
+    prim.vertices.reserve(slices * (stacks + 1) + 2);
+
+    // stacks + 1 rings from the bottom up, then the bottom and top cap centres
+    for (int k = 0; k <= stacks; ++k) {
+        float z = base.z + height * k / stacks;
+        for (int j = 0; j < slices; ++j) {
+            double phi = startAngle + 2 * CV_PI * j / slices;
+            prim.vertices.push_back(cv::Point3f(base.x + radius * (float)cos(phi),
+                                                base.y + radius * (float)sin(phi), z));
+        }
+    }
+    int bottom = (int)prim.vertices.size();
+    prim.vertices.push_back(base);
+    int top = (int)prim.vertices.size();
+    prim.vertices.push_back(cv::Point3f(base.x, base.y, base.z + height));
+
+    auto ring = [slices](int k, int j) { return k * slices + (j % slices); };
+
+    for (int j = 0; j < slices; ++j) {
+        for (int k = 0; k <= stacks; ++k) {
+            addEdge(prim, ring(k, j), ring(k, j + 1));
+        }
+        for (int k = 0; k < stacks; ++k) {
+            addEdge(prim, ring(k, j), ring(k + 1, j));
+            addTriangle(prim, ring(k + 1, j), ring(k, j), ring(k, j + 1));
+            addTriangle(prim, ring(k + 1, j), ring(k, j + 1), ring(k + 1, j + 1));
+        }
+        addTriangle(prim, bottom, ring(0, j + 1), ring(0, j));
+        addTriangle(prim, top, ring(stacks, j), ring(stacks, j + 1));
+    }
+
+    return prim;
+}
+
+
+Primitive makePrism(const cv::Point3f &base, float radius, float height, int sides, float startAngle) {
+    return makeCylinder(base, radius, height, sides, 1, startAngle);
+}
@@ -0,0 +1,31 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: parametric shapes (spheres, ellipsoids, prisms, cylinders) with edge and triangle topology
+
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Vertices of a generated shape together with its wireframe edges (vertex index pairs)
+// and triangles (vertex index triples, counter-clockwise when seen from outside)
+struct Primitive {
+    std::vector<cv::Point3f> vertices;
+    std::vector<int> edges;
+    std::vector<int> triangles;
+};
+
+// Latitude/longitude ellipsoid: slices meridians around the z axis, stacks bands from pole to pole.
+// Edge and triangle counts grow linearly with slices * stacks.
+Primitive makeEllipsoid(const cv::Point3f &center, const cv::Point3f &radii, int slices, int stacks);
+Primitive makeSphere(const cv::Point3f &center, float radius, int slices, int stacks);
+
+// Cylinder standing on the plane z = base.z, split into stacks bands along its height.
+// startAngle (radians) places the first vertex of each ring.
+Primitive makeCylinder(const cv::Point3f &base, float radius, float height, int slices, int stacks,
+                       float startAngle = 0);
+
+// Regular n-sided prism: a cylinder with one band and n sides
+Primitive makePrism(const cv::Point3f &base, float radius, float height, int sides, float startAngle = 0);
+
+#endif
@@ -0,0 +1,249 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: per-vertex distortion vs undistort-once rendering, projection and rasterization cost per frame
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include "mesh.h"
+#include "scene.h"
+#include "rectify.h"
+#include "rasterizer.h"
+#include "primitives.h"
+#include "board_texture.h"
+#include "camera_model.h"
+
+// Median time of one call in milliseconds
+static double timeMs(int iterations, const std::function<void()> &run) {
+    std::vector<double> times(iterations);
+    run();  // warm-up
+    for (int i = 0; i < iterations; ++i) {
+        int64 start = cv::getTickCount();
+        run();
+        times[i] = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+    }
+    std::nth_element(times.begin(), times.begin() + iterations / 2, times.end());
+    return times[iterations / 2];
+}
+
+
+// Triangle mesh of a generated shape, for rasterizer timing without a large model file
+static void meshFromPrimitive(const Primitive &prim, Mesh &mesh) {
+    mesh.vertexData = prim.vertices;
+    mesh.indexData = prim.triangles;
+    mesh.offsetData.clear();
+    for (size_t i = 0; i <= prim.triangles.size(); i += 3) {
+        mesh.offsetData.push_back((int)i);
+    }
+    mesh.vertices = mesh.vertexData.data();
+    mesh.indices = mesh.indexData.data();
+    mesh.faceOffsets = mesh.offsetData.data();
+    mesh.numVertices = (int)mesh.vertexData.size();
+    mesh.numIndices = (int)mesh.indexData.size();
+    mesh.numFaces = (int)mesh.offsetData.size() - 1;
+}
+
+
+int main(int argc, char *argv[]) {
+    cv::Size size(1280, 720);
+    int lod = 20;
+    int iterations = 200;
+    std::string meshFilename = "cup.obj";
+    int rasterTriangles = 100000;
+    std::string textureFilename = "brick.jpeg";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &size.width, &size.height);
+        } else if (strcmp(argv[i], "--lod") == 0 && i + 1 < argc) {
+            lod = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            meshFilename = argv[++i];
+        } else if (strcmp(argv[i], "--triangles") == 0 && i + 1 < argc) {
+            rasterTriangles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--texture") == 0 && i + 1 < argc) {
+            textureFilename = argv[++i];
+        }
+    }
+
+    // A typical webcam calibration and a board pose in front of it
+    cv::Mat camera_matrix = (cv::Mat_<double>(3, 3) << 0.9 * size.width, 0, size.width / 2.0,
+                                                       0, 0.9 * size.width, size.height / 2.0,
+                                                       0, 0, 1);
+    std::vector<double> distortion = {-0.28, 0.09, 0.001, -0.0005, -0.01};
+    cv::Mat rvec = (cv::Mat_<double>(3, 1) << 0.3, -0.2, 0.1);
+    cv::Mat tvec = (cv::Mat_<double>(3, 1) << -3.0, 2.0, 20.0);
+
+    Scene scene;
+    buildDemoScene(scene, lod);
+    std::vector<cv::Point3f> meshVertices;
+    MeshHandle mesh = loadMesh(meshFilename);
+    if (mesh) {
+        meshVertices.assign(mesh->vertices, mesh->vertices + mesh->numVertices);
+    }
+    int vertexCount = (int)(scene.vertices.size() + meshVertices.size());
+    std::vector<cv::Point2f> meshProjected(meshVertices.size());
+
+    cv::Mat frame(size, CV_8UC3), rectified;
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    IntrinsicsPtr intrinsics = makeIntrinsics(camera_matrix, distortion);
+    RectifyCache cache;
+    double buildMs = timeMs(1, [&]() {
+        cache.maps.reset();
+        rectifyMaps(cache, intrinsics, size);
+    });
+    RectifyMapsPtr maps = rectifyMaps(cache, intrinsics, size);
+    const cv::Mat &pinhole_matrix = maps->rectified->camera_matrix;
+    std::vector<double> none;
+
+    double distortedMs = timeMs(iterations, [&]() {
+        projectScene(scene, rvec, tvec, camera_matrix, distortion);
+        if (!meshVertices.empty()) {
+            cv::projectPoints(meshVertices, rvec, tvec, camera_matrix, distortion, meshProjected);
+        }
+    });
+    double projectPointsMs = timeMs(iterations, [&]() {
+        cv::projectPoints(scene.vertices, rvec, tvec, pinhole_matrix, none, scene.projected);
+        if (!meshVertices.empty()) {
+            cv::projectPoints(meshVertices, rvec, tvec, pinhole_matrix, none, meshProjected);
+        }
+    });
+    double pinholeMs = timeMs(iterations, [&]() {
+        projectScene(scene, rvec, tvec, pinhole_matrix, none);
+        projectPinhole(meshVertices.data(), (int)meshVertices.size(), rvec, tvec, pinhole_matrix, meshProjected.data());
+    });
+    double remapMs = timeMs(iterations, [&]() {
+        rectifyFrame(*maps, frame, rectified);
+    });
+
+    // The fast kernel has to agree with projectPoints on the same pinhole camera
+    std::vector<cv::Point2f> reference, fast(scene.vertices.size());
+    cv::projectPoints(scene.vertices, rvec, tvec, pinhole_matrix, none, reference);
+    projectPinhole(scene.vertices.data(), (int)scene.vertices.size(), rvec, tvec, pinhole_matrix, fast.data());
+    double maxError = 0;
+    for (size_t i = 0; i < fast.size(); ++i) {
+        maxError = std::max(maxError, (double)cv::norm(fast[i] - reference[i]));
+    }
+
+    // Specialised kernels against projectPoints for each lens model, at the vertex counts drawn
+    // per frame: the board corners, the scene and the mesh
+    struct ModelCase {
+        DistortionModel model;
+        std::vector<double> coefficients;
+    };
+    std::vector<ModelCase> modelCases = {
+        {DISTORTION_NONE, {}},
+        {DISTORTION_RADIAL2, {-0.28, 0.09}},
+        {DISTORTION_FULL5, distortion},
+        {DISTORTION_FULL8, {-0.28, 0.09, 0.001, -0.0005, -0.01, 0.02, -0.005, 0.001}},
+    };
+    struct VertexSet {
+        const char *name;
+        std::vector<cv::Point3f> points;
+    };
+    std::vector<VertexSet> vertexSets = {
+        {"board", std::vector<cv::Point3f>(DemoBoard::points(), DemoBoard::points() + DemoBoard::corners)},
+        {"scene", scene.vertices},
+    };
+    if (!meshVertices.empty()) {
+        vertexSets.push_back({"mesh", meshVertices});
+    }
+    struct ModelTiming {
+        const char *set;
+        int count;
+        DistortionModel model;
+        double projectPointsMs, kernelMs, maxError;
+    };
+    std::vector<ModelTiming> modelTimings;
+    std::vector<cv::Point2f> modelReference, modelFast;
+    for (const VertexSet &set : vertexSets) {
+        int count = (int)set.points.size();
+        for (const ModelCase &c : modelCases) {
+            ProjectionCamera camera;
+            makeProjectionCamera(rvec, tvec, camera_matrix, c.coefficients, camera);
+            modelFast.resize(count);
+            double referenceMs = timeMs(iterations, [&]() {
+                cv::projectPoints(set.points, rvec, tvec, camera_matrix, c.coefficients, modelReference);
+            });
+            double kernelMs = timeMs(iterations, [&]() {
+                projectCamera(camera, set.points.data(), count, modelFast.data());
+            });
+            double error = 0;
+            for (int i = 0; i < count; ++i) {
+                error = std::max(error, (double)cv::norm(modelFast[i] - modelReference[i]));
+            }
+            modelTimings.push_back({set.name, count, camera.model, referenceMs, kernelMs, error});
+        }
+    }
+
+    // The board with its corner count and lens model both fixed at compile time
+    cv::Point2f boardProjected[DemoBoard::corners];
+    ProjectionCamera boardCamera;
+    makeProjectionCamera(rvec, tvec, camera_matrix, distortion, boardCamera);
+    double boardMs = timeMs(iterations, [&]() {
+        projectBoard<DemoBoard, DISTORTION_FULL5>(boardCamera, boardProjected);
+    });
+
+    // Filled rendering of a sphere over the board with about rasterTriangles triangles
+    int bands = std::max(4, (int)std::sqrt(rasterTriangles / 2.0));
+    Mesh sphere;
+    meshFromPrimitive(makeSphere(cv::Point3f(3, -4, 4), 4.0f, bands, bands), sphere);
+    MeshRenderer renderer;
+    cv::Mat canvas = frame.clone();
+    double rasterMs = timeMs(iterations, [&]() {
+        renderMesh(renderer, canvas, &sphere, rvec, tvec, pinhole_matrix, none);
+    });
+    // The thread count is fixed once a renderer's pool is up, so one thread gets its own renderer
+    MeshRenderer single;
+    single.threads = 1;
+    double rasterOneThreadMs = timeMs(std::max(1, iterations / 4), [&]() {
+        renderMesh(single, canvas, &sphere, rvec, tvec, pinhole_matrix, none);
+    });
+
+    // Board texture: the cached box-only warp against warping the full frame
+    BoardTexture texture;
+    if (!loadBoardTexture(textureFilename, texture)) {
+        cv::Mat image(1024, 1024, CV_8UC3);
+        cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+        buildTextureLevels(image, texture);
+    }
+    texture.area = boardArea(cv::Size(6, 9));
+    double textureMs = timeMs(iterations, [&]() {
+        drawBoardTexture(texture, canvas, rvec, tvec, pinhole_matrix, none);
+    });
+    cv::Mat fullHomography = cv::getPerspectiveTransform(
+        std::vector<cv::Point2f>{{0, 0}, {(float)texture.levels[0].cols, 0},
+                                 {(float)texture.levels[0].cols, (float)texture.levels[0].rows}, {0, (float)texture.levels[0].rows}},
+        texture.projected);
+    cv::Mat fullWarp;
+    double fullWarpMs = timeMs(iterations, [&]() {
+        cv::warpPerspective(texture.levels[0], fullWarp, fullHomography, size);
+    });
+
+    printf("%d vertices, %dx%d frame, median of %d runs\n", vertexCount, size.width, size.height, iterations);
+    printf("  table build (once per calibration)   %8.3f ms\n", buildMs);
+    printf("  projectPoints with distortion        %8.3f ms\n", distortedMs);
+    printf("  projectPoints, pinhole               %8.3f ms\n", projectPointsMs);
+    printf("  pinhole kernel                       %8.3f ms  (max diff %.2g px)\n", pinholeMs, maxError);
+    printf("  remap frame, fixed point             %8.3f ms\n", remapMs);
+    printf("Per frame: distortion per vertex %.3f ms, undistort once %.3f ms\n", distortedMs, remapMs + pinholeMs);
+    printf("Projection kernels against projectPoints\n");
+    for (const ModelTiming &t : modelTimings) {
+        printf("  %-5s %6d vertices, %-6s  projectPoints %8.4f ms  kernel %8.4f ms  %5.1fx  (max diff %.2g px)\n",
+               t.set, t.count, distortionModelName(t.model), t.projectPointsMs, t.kernelMs,
+               t.kernelMs > 0 ? t.projectPointsMs / t.kernelMs : 0.0, t.maxError);
+    }
+    printf("  board <6x9, 5-coef> fixed at compile time              %8.4f ms\n", boardMs);
+    printf("Filled mesh, %d triangles (%d drawn, %d back faces culled, %d outside)\n", renderer.trianglesTotal,
+           renderer.trianglesDrawn, renderer.culledBack, renderer.culledFrustum);
+    printf("  tiled rasterizer, all cores          %8.3f ms  (%.0f FPS)\n", rasterMs, rasterMs > 0 ? 1000.0 / rasterMs : 0.0);
+    printf("  tiled rasterizer, one thread         %8.3f ms\n", rasterOneThreadMs);
+    printf("Board texture, %dx%d image\n", texture.levels[0].cols, texture.levels[0].rows);
+    printf("  warpPerspective, full frame          %8.3f ms\n", fullWarpMs);
+    printf("  board box, mip level %d               %8.3f ms\n", texture.lastLevel, textureMs);
+    return 0;
+}
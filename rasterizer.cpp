@@ -0,0 +1,264 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: filled, depth-tested mesh rendering on the CPU with a tiled rasterizer
+
+#include "rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include "alloc_counter.h"
+#include "camera_model.h"
+
+enum RasterState : uint8_t {
+    RASTER_VISIBLE,
+    RASTER_BACK,
+    RASTER_OUTSIDE
+};
+
+// Triangles set up per task
+static const int setupChunk = 4096;
+
+
+bool parseShadeMode(const std::string &name, ShadeMode &mode) {
+    if (name == "flat") {
+        mode = SHADE_FLAT;
+    } else if (name == "lambert") {
+        mode = SHADE_LAMBERT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// Fan-triangulate every face once per mesh
+static void triangulate(MeshRenderer &renderer, MeshHandle mesh) {
+    renderer.triangles.clear();
+    for (int f = 0; f < mesh->numFaces; ++f) {
+        int begin = mesh->faceOffsets[f], end = mesh->faceOffsets[f + 1];
+        for (int i = begin + 1; i + 1 < end; ++i) {
+            renderer.triangles.push_back(mesh->indices[begin]);
+            renderer.triangles.push_back(mesh->indices[i]);
+            renderer.triangles.push_back(mesh->indices[i + 1]);
+        }
+    }
+    renderer.triangulated = mesh;
+}
+
+
+// Cull, orient and build the edge and depth planes of one triangle
+static void setupTriangle(const MeshRenderer &renderer, const int *index, cv::Size frameSize,
+                          const cv::Vec3f &light, RasterTriangle &tri) {
+    const cv::Point3f &p0 = renderer.cameraPoints[index[0]];
+    const cv::Point3f &p1 = renderer.cameraPoints[index[1]];
+    const cv::Point3f &p2 = renderer.cameraPoints[index[2]];
+    float nearPlane = renderer.nearPlane;
+    if (p0.z < nearPlane || p1.z < nearPlane || p2.z < nearPlane) {
+        tri.state = RASTER_OUTSIDE;
+        return;
+    }
+
+    // Seen from the camera at the origin, a front face's normal points back towards it
+    cv::Point3f normal = (p1 - p0).cross(p2 - p0);
+    float facing = normal.dot(p0);
+    if (renderer.cullBackFaces && facing >= 0) {
+        tri.state = RASTER_BACK;
+        return;
+    }
+
+    cv::Point2f s[3] = {renderer.imagePoints[index[0]], renderer.imagePoints[index[1]], renderer.imagePoints[index[2]]};
+    for (const cv::Point2f &p : s) {
+        // Far off-axis or through a wild distortion polynomial, a projection can blow up
+        if (!std::isfinite(p.x) || !std::isfinite(p.y)) {
+            tri.state = RASTER_OUTSIDE;
+            return;
+        }
+    }
+    float invDepth[3] = {1.0f / p0.z, 1.0f / p1.z, 1.0f / p2.z};
+    float minX = std::min(s[0].x, std::min(s[1].x, s[2].x)), maxX = std::max(s[0].x, std::max(s[1].x, s[2].x));
+    float minY = std::min(s[0].y, std::min(s[1].y, s[2].y)), maxY = std::max(s[0].y, std::max(s[1].y, s[2].y));
+    // Clamped to the frame in float, so the conversions below stay in range
+    float right = (float)frameSize.width - 1, bottom = (float)frameSize.height - 1;
+    tri.minX = (int)std::ceil(std::min(std::max(0.0f, minX), right + 1));
+    tri.minY = (int)std::ceil(std::min(std::max(0.0f, minY), bottom + 1));
+    tri.maxX = (int)std::floor(std::max(std::min(right, maxX), -1.0f));
+    tri.maxY = (int)std::floor(std::max(std::min(bottom, maxY), -1.0f));
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+        tri.state = RASTER_OUTSIDE;   // off screen, or too small to cover a pixel centre
+        return;
+    }
+
+    float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[2].x - s[0].x) * (s[1].y - s[0].y);
+    if (std::fabs(area) < 1e-6f) {
+        tri.state = RASTER_BACK;   // seen edge-on
+        return;
+    }
+    if (area < 0) {
+        std::swap(s[1], s[2]);
+        std::swap(invDepth[1], invDepth[2]);
+        area = -area;
+    }
+
+    // Edge k is opposite vertex k, so edge k over the area is vertex k's barycentric weight
+    tri.depthA = tri.depthB = tri.depthC = 0;
+    for (int k = 0; k < 3; ++k) {
+        const cv::Point2f &a = s[(k + 1) % 3];
+        const cv::Point2f &b = s[(k + 2) % 3];
+        tri.edgeA[k] = a.y - b.y;
+        tri.edgeB[k] = b.x - a.x;
+        tri.edgeC[k] = a.x * b.y - a.y * b.x;
+        tri.depthA += tri.edgeA[k] * invDepth[k];
+        tri.depthB += tri.edgeB[k] * invDepth[k];
+        tri.depthC += tri.edgeC[k] * invDepth[k];
+    }
+    tri.depthA /= area;
+    tri.depthB /= area;
+    tri.depthC /= area;
+
+    float intensity = 1.0f;
+    if (renderer.shading == SHADE_LAMBERT) {
+        float length = std::sqrt(normal.dot(normal));
+        cv::Vec3f n(normal.x, normal.y, normal.z);
+        n *= (facing < 0 ? 1.0f : -1.0f) / length;   // towards the camera, also for back faces left in
+        intensity = renderer.ambient + (1.0f - renderer.ambient) * std::max(0.0f, n.dot(light));
+    }
+    tri.color = cv::Vec3b(cv::saturate_cast<uchar>(renderer.color[0] * intensity),
+                          cv::saturate_cast<uchar>(renderer.color[1] * intensity),
+                          cv::saturate_cast<uchar>(renderer.color[2] * intensity));
+    tri.state = RASTER_VISIBLE;
+}
+
+
+// Fill one tile: per row, the span inside all three edges comes straight from the edge
+// functions, so the inner loop only interpolates depth and tests it
+static void rasterizeTile(MeshRenderer &renderer, cv::Mat &frame, int tile, int tilesX, std::vector<float> &depth) {
+    int size = renderer.tileSize;
+    int tileX = (tile % tilesX) * size, tileY = (tile / tilesX) * size;
+    int tileRight = std::min(tileX + size, frame.cols) - 1, tileBottom = std::min(tileY + size, frame.rows) - 1;
+    std::fill(depth.begin(), depth.end(), 0.0f);
+
+    for (int index : renderer.bins[tile]) {
+        const RasterTriangle &tri = renderer.setup[index];
+        int top = std::max(tri.minY, tileY), bottom = std::min(tri.maxY, tileBottom);
+        for (int y = top; y <= bottom; ++y) {
+            float fy = (float)y;
+            float left = (float)std::max(tri.minX, tileX), right = (float)std::min(tri.maxX, tileRight);
+            for (int k = 0; k < 3; ++k) {
+                float a = tri.edgeA[k], r = tri.edgeB[k] * fy + tri.edgeC[k];
+                if (a > 0) {
+                    left = std::max(left, std::ceil(-r / a));
+                } else if (a < 0) {
+                    right = std::min(right, std::floor(-r / a));
+                } else if (r < 0) {
+                    right = left - 1;
+                }
+            }
+            if (left > right) {
+                continue;
+            }
+
+            int x0 = (int)left, x1 = (int)right;
+            float z = tri.depthA * left + tri.depthB * fy + tri.depthC;
+            float *d = depth.data() + (y - tileY) * size;
+            cv::Vec3b *pixel = frame.ptr<cv::Vec3b>(y);
+            for (int x = x0; x <= x1; ++x, z += tri.depthA) {
+                if (z > d[x - tileX]) {
+                    d[x - tileX] = z;
+                    pixel[x] = tri.color;
+                }
+            }
+        }
+    }
+}
+
+
+void renderMesh(MeshRenderer &renderer, cv::Mat &frame, MeshHandle mesh, const cv::Mat &rvec, const cv::Mat &tvec,
+                const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff) {
+    renderer.trianglesTotal = renderer.culledBack = renderer.culledFrustum = renderer.trianglesDrawn = 0;
+    if (!mesh || mesh->numVertices == 0 || frame.type() != CV_8UC3) {
+        return;
+    }
+    if (renderer.triangulated != mesh) {
+        triangulate(renderer, mesh);
+    }
+    int count = (int)renderer.triangles.size() / 3;
+    renderer.trianglesTotal = count;
+
+    // Camera-space vertices for culling and depth
+    cv::Matx33d R;
+    {
+        LibraryScope library;
+        cv::Rodrigues(rvec, R);
+    }
+    cv::Matx33f Rf = R;
+    cv::Point3f t((float)tvec.at<double>(0), (float)tvec.at<double>(1), (float)tvec.at<double>(2));
+    renderer.cameraPoints.resize(mesh->numVertices);
+    for (int i = 0; i < mesh->numVertices; ++i) {
+        const cv::Point3f &v = mesh->vertices[i];
+        renderer.cameraPoints[i] = cv::Point3f(Rf(0, 0) * v.x + Rf(0, 1) * v.y + Rf(0, 2) * v.z + t.x,
+                                               Rf(1, 0) * v.x + Rf(1, 1) * v.y + Rf(1, 2) * v.z + t.y,
+                                               Rf(2, 0) * v.x + Rf(2, 1) * v.y + Rf(2, 2) * v.z + t.z);
+    }
+
+    // Image positions: straight from camera space for a pinhole camera, through the
+    // distortion model otherwise
+    renderer.imagePoints.resize(mesh->numVertices);
+    if (dist_coeff.empty()) {
+        float fx = (float)camera_matrix.at<double>(0, 0), skew = (float)camera_matrix.at<double>(0, 1);
+        float cx = (float)camera_matrix.at<double>(0, 2);
+        float fy = (float)camera_matrix.at<double>(1, 1), cy = (float)camera_matrix.at<double>(1, 2);
+        for (int i = 0; i < mesh->numVertices; ++i) {
+            const cv::Point3f &p = renderer.cameraPoints[i];
+            float iz = p.z > 0 ? 1.0f / p.z : 0.0f;
+            renderer.imagePoints[i] = cv::Point2f(fx * p.x * iz + skew * p.y * iz + cx, fy * p.y * iz + cy);
+        }
+    } else {
+        projectFast(mesh->vertices, mesh->numVertices, rvec, tvec, camera_matrix, dist_coeff, renderer.imagePoints);
+    }
+
+    // The pool's threads start with the first frame and stay up
+    startWorkPool(renderer.pool, renderer.threads);
+    int threads = renderer.pool.threads;
+    cv::Vec3f light = cv::normalize(renderer.light);
+    cv::Size frameSize = frame.size();
+    renderer.setup.resize(count);
+    int tileSize = renderer.tileSize;
+    int tilesX = (frame.cols + tileSize - 1) / tileSize, tilesY = (frame.rows + tileSize - 1) / tileSize;
+    renderer.bins.resize(tilesX * tilesY);
+    renderer.depthTiles.resize(threads);
+    for (std::vector<float> &depth : renderer.depthTiles) {
+        depth.resize(tileSize * tileSize);
+    }
+
+    // Set up triangles in parallel chunks
+    parallelForStealing(renderer.pool, (count + setupChunk - 1) / setupChunk, [&](int chunk, int) {
+        int end = std::min(count, (chunk + 1) * setupChunk);
+        for (int i = chunk * setupChunk; i < end; ++i) {
+            setupTriangle(renderer, &renderer.triangles[3 * i], frameSize, light, renderer.setup[i]);
+        }
+    });
+
+    // Bin the visible triangles into every tile their bounds touch
+    for (std::vector<int> &bin : renderer.bins) {
+        bin.clear();
+    }
+    for (int i = 0; i < count; ++i) {
+        const RasterTriangle &tri = renderer.setup[i];
+        if (tri.state != RASTER_VISIBLE) {
+            (tri.state == RASTER_BACK ? renderer.culledBack : renderer.culledFrustum)++;
+            continue;
+        }
+        renderer.trianglesDrawn++;
+        for (int ty = tri.minY / tileSize; ty <= tri.maxY / tileSize; ++ty) {
+            for (int tx = tri.minX / tileSize; tx <= tri.maxX / tileSize; ++tx) {
+                renderer.bins[ty * tilesX + tx].push_back(i);
+            }
+        }
+    }
+
+    // Tiles own disjoint pixels, so they rasterize without locking
+    parallelForStealing(renderer.pool, tilesX * tilesY, [&](int tile, int thread) {
+        if (!renderer.bins[tile].empty()) {
+            rasterizeTile(renderer, frame, tile, tilesX, renderer.depthTiles[thread]);
+        }
+    });
+}
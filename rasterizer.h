@@ -0,0 +1,71 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: filled, depth-tested mesh rendering on the CPU with a tiled rasterizer
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "mesh.h"
+#include "work_pool.h"
+
+enum ShadeMode {
+    SHADE_FLAT,      // one colour for the whole mesh
+    SHADE_LAMBERT    // per-face diffuse lighting from a light fixed to the camera
+};
+
+// One triangle after setup: edge functions A*x + B*y + C that are >= 0 inside,
+// inverse depth as a plane over the image, and its clipped pixel bounds
+struct RasterTriangle {
+    float edgeA[3], edgeB[3], edgeC[3];
+    float depthA, depthB, depthC;
+    int minX, minY, maxX, maxY;
+    cv::Vec3b color;
+    uint8_t state;   // RASTER_VISIBLE or why it was culled
+};
+
+// Renders a mesh as filled triangles onto the camera frame. Faces are fan-triangulated once
+// per mesh. Each frame the vertices are moved into camera space, triangles facing away or
+// outside the view are culled, and the rest are binned into screen tiles. The tiles are then
+// rasterized in parallel on the renderer's own threads, each with its own z-buffer, writing
+// straight into the frame.
+// Triangles that cross the near plane are dropped rather than clipped.
+struct MeshRenderer {
+    // Settings
+    ShadeMode shading = SHADE_LAMBERT;
+    cv::Vec3f color = cv::Vec3f(40, 180, 230);     // BGR
+    cv::Vec3f light = cv::Vec3f(-0.3f, -0.5f, -1.0f);   // towards the light, camera coordinates
+    float ambient = 0.3f;
+    bool cullBackFaces = true;    // faces are counter-clockwise seen from outside
+    float nearPlane = 0.05f;      // world units in front of the camera
+    int tileSize = 64;
+    int threads = 0;              // 0 uses every core
+
+    WorkPool pool;                // started with the first frame drawn
+
+    // Triangles of the mesh last drawn, 3 vertex indices each
+    MeshHandle triangulated = nullptr;
+    std::vector<int> triangles;
+
+    // Scratch reused every frame
+    std::vector<cv::Point3f> cameraPoints;
+    std::vector<cv::Point2f> imagePoints;
+    std::vector<RasterTriangle> setup;
+    std::vector<std::vector<int>> bins;         // triangles overlapping each tile
+    std::vector<std::vector<float>> depthTiles; // one tile of inverse depth per thread
+
+    // What the last frame did
+    int trianglesTotal = 0;
+    int culledBack = 0;
+    int culledFrustum = 0;
+    int trianglesDrawn = 0;
+};
+
+bool parseShadeMode(const std::string &name, ShadeMode &mode);
+
+// Draw mesh at the board pose onto an 8-bit BGR frame
+void renderMesh(MeshRenderer &renderer, cv::Mat &frame, MeshHandle mesh, const cv::Mat &rvec, const cv::Mat &tvec,
+                const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff);
+
+#endif
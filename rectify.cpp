@@ -0,0 +1,99 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: undistort-once rendering: cached remap tables and a pinhole-only projection
+
+#include "rectify.h"
+
+#include "simd_compat.h"
+
+static bool hasDistortion(const std::vector<double> &dist_coeff) {
+    for (double k : dist_coeff) {
+        if (k != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+RectifyMapsPtr rectifyMaps(RectifyCache &cache, const IntrinsicsPtr &intrinsics, cv::Size size) {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.maps && cache.maps->intrinsics == intrinsics && cache.maps->size == size) {
+        return cache.maps;
+    }
+
+    std::shared_ptr<RectifyMaps> maps = std::make_shared<RectifyMaps>();
+    maps->intrinsics = intrinsics;
+    maps->size = size;
+    if (hasDistortion(intrinsics->distortion_coefficients)) {
+        // alpha 0 keeps only valid pixels, so the undistorted frame has no black border
+        cv::Mat camera_matrix = cv::getOptimalNewCameraMatrix(intrinsics->camera_matrix, intrinsics->distortion_coefficients, size, 0);
+        cv::initUndistortRectifyMap(intrinsics->camera_matrix, intrinsics->distortion_coefficients, cv::Mat(), camera_matrix,
+                                    size, CV_16SC2, maps->map1, maps->map2);
+        maps->rectified = makeIntrinsics(camera_matrix, std::vector<double>());
+    } else {
+        maps->rectified = makeIntrinsics(intrinsics->camera_matrix, std::vector<double>());
+    }
+
+    cache.maps = maps;
+    cache.rebuilds++;
+    return maps;
+}
+
+
+void rectifyFrame(const RectifyMaps &maps, const cv::Mat &frame, cv::Mat &rectified) {
+    if (maps.map1.empty()) {
+        rectified = frame;
+        return;
+    }
+    cv::remap(frame, rectified, maps.map1, maps.map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+}
+
+
+void projectPinhole(const cv::Point3f *points, int count, const cv::Mat &rvec, const cv::Mat &tvec,
+                    const cv::Mat &camera_matrix, cv::Point2f *projected) {
+    cv::Matx33d R;
+    cv::Rodrigues(rvec, R);
+    const double fx = camera_matrix.at<double>(0, 0), cx = camera_matrix.at<double>(0, 2);
+    const double fy = camera_matrix.at<double>(1, 1), cy = camera_matrix.at<double>(1, 2);
+    const double t[3] = {tvec.at<double>(0), tvec.at<double>(1), tvec.at<double>(2)};
+
+    // Rows of K[R|t]: u = (P0.X) / (P2.X), v = (P1.X) / (P2.X)
+    float P[12];
+    for (int j = 0; j < 3; ++j) {
+        P[j] = (float)(fx * R(0, j) + cx * R(2, j));
+        P[4 + j] = (float)(fy * R(1, j) + cy * R(2, j));
+        P[8 + j] = (float)R(2, j);
+    }
+    P[3] = (float)(fx * t[0] + cx * t[2]);
+    P[7] = (float)(fy * t[1] + cy * t[2]);
+    P[11] = (float)t[2];
+
+    const float *src = &points[0].x;
+    float *dst = &projected[0].x;
+    int i = 0;
+#if CV_SIMD && !CV_SIMD_SCALABLE
+    // The coefficients are kept in an array of vectors, which scalable vectors cannot be
+    const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+    cv::v_float32 p[12];
+    for (int j = 0; j < 12; ++j) {
+        p[j] = cv::vx_setall_f32(P[j]);
+    }
+    cv::v_float32 one = cv::vx_setall_f32(1.0f);
+    for (; i <= count - lanes; i += lanes) {
+        cv::v_float32 x, y, z;
+        cv::v_load_deinterleave(src + 3 * i, x, y, z);
+        cv::v_float32 u = cv::v_fma(p[0], x, cv::v_fma(p[1], y, cv::v_fma(p[2], z, p[3])));
+        cv::v_float32 v = cv::v_fma(p[4], x, cv::v_fma(p[5], y, cv::v_fma(p[6], z, p[7])));
+        cv::v_float32 w = cv::v_fma(p[8], x, cv::v_fma(p[9], y, cv::v_fma(p[10], z, p[11])));
+        cv::v_float32 iw = cv::v_div(one, w);
+        cv::v_store_interleave(dst + 2 * i, cv::v_mul(u, iw), cv::v_mul(v, iw));
+    }
+    cv::vx_cleanup();
+#endif
+    for (; i < count; ++i) {
+        float x = src[3 * i], y = src[3 * i + 1], z = src[3 * i + 2];
+        float iw = 1.0f / (P[8] * x + P[9] * y + P[10] * z + P[11]);
+        dst[2 * i] = (P[0] * x + P[1] * y + P[2] * z + P[3]) * iw;
+        dst[2 * i + 1] = (P[4] * x + P[5] * y + P[6] * z + P[7]) * iw;
+    }
+}
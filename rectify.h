@@ -0,0 +1,41 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: undistort-once rendering: cached remap tables and a pinhole-only projection
+
+#ifndef RECTIFY_H
+#define RECTIFY_H
+
+#include <atomic>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include "intrinsics.h"
+
+// Fixed-point remap tables that undistort whole frames for one calibration. Overlays
+// drawn on the undistorted frame use `rectified`, a pinhole model without distortion,
+// so no distortion polynomial is evaluated per vertex.
+struct RectifyMaps {
+    IntrinsicsPtr intrinsics;   // calibration the tables were built from
+    IntrinsicsPtr rectified;    // pinhole camera of the undistorted frame
+    cv::Size size;
+    cv::Mat map1, map2;         // CV_16SC2 + CV_16UC1, empty when there is no distortion to remove
+};
+
+typedef std::shared_ptr<const RectifyMaps> RectifyMapsPtr;
+
+// Tables shared by the frame workers, rebuilt only when the calibration or frame size changes
+struct RectifyCache {
+    std::mutex mutex;
+    RectifyMapsPtr maps;
+    std::atomic<int> rebuilds{0};
+};
+
+RectifyMapsPtr rectifyMaps(RectifyCache &cache, const IntrinsicsPtr &intrinsics, cv::Size size);
+
+// Undistort a frame with the cached tables; without tables rectified shares frame's data
+void rectifyFrame(const RectifyMaps &maps, const cv::Mat &frame, cv::Mat &rectified);
+
+// projectPoints for a distortion-free camera: K[R|t] is folded into one 3x4 matrix and
+// the points go through it a vector of lanes at a time
+void projectPinhole(const cv::Point3f *points, int count, const cv::Mat &rvec, const cv::Mat &tvec,
+                    const cv::Mat &camera_matrix, cv::Point2f *projected);
+
+#endif
@@ -0,0 +1,80 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: static wireframe scene projected onto the target in one batch
+
+#include "scene.h"
+#include "rectify.h"
+#include "camera_model.h"
+
+#include <algorithm>
+
+void addObject(Scene &scene, const std::vector<cv::Point3f> &points, const std::vector<int> &edges,
+               const cv::Scalar &color, int thickness) {
+    int base = (int)scene.vertices.size();
+    scene.vertices.insert(scene.vertices.end(), points.begin(), points.end());
+
+    SceneBatch batch;
+    batch.firstEdge = (int)scene.edges.size() / 2;
+    batch.numEdges = (int)edges.size() / 2;
+    batch.color = color;
+    batch.thickness = thickness;
+    for (int idx : edges) {
+        scene.edges.push_back(base + idx);
+    }
+    scene.batches.push_back(batch);
+
+    // Size the output once so projecting never has to grow it
+    scene.projected.resize(scene.vertices.size());
+}
+
+
+void addPrimitive(Scene &scene, const Primitive &prim, const cv::Scalar &color, int thickness) {
+    addObject(scene, prim.vertices, prim.edges, color, thickness);
+}
+
+
+void buildDemoScene(Scene &scene, int detail) {
+    int slices = std::max(detail, 3);
+    int stacks = std::max(detail / 2, 2);
+
+    // Hexagonal prism with unit sides, first bottom vertex on the board origin
+    addPrimitive(scene, makePrism(cv::Point3f(0.5f, 0.866f, 0), 1.0f, 1.0f, 6, (float)(4 * CV_PI / 3)),
+                 cv::Scalar(0, 255, 255), 2);
+
+    // Unit cubes attached to either side of the hexagonal prism
+    float halfDiagonal = (float)sqrt(0.5);
+    addPrimitive(scene, makePrism(cv::Point3f(0.5f + 0.75f, 0.5f, 0), halfDiagonal, 1.0f, 4, (float)(5 * CV_PI / 4)),
+                 cv::Scalar(255, 0, 255), 2);
+    addPrimitive(scene, makePrism(cv::Point3f(0.5f - 0.75f, 0.5f, 0), halfDiagonal, 1.0f, 4, (float)(5 * CV_PI / 4)),
+                 cv::Scalar(255, 0, 255), 2);
+
+    // Football floating above the board to the right
+    addPrimitive(scene, makeEllipsoid(cv::Point3f(5.4f, -0.4f, 3.4f), cv::Point3f(1.3f, 1.0f, 1.0f), slices, stacks),
+                 cv::Scalar(0, 255, 255), 1);
+}
+
+
+void projectScene(Scene &scene, const cv::Mat &rvec, const cv::Mat &tvec,
+                  const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff) {
+    if (scene.vertices.empty()) {
+        return;
+    }
+    if (dist_coeff.empty()) {
+        // Undistorted frame: pinhole fast path
+        scene.projected.resize(scene.vertices.size());
+        projectPinhole(scene.vertices.data(), (int)scene.vertices.size(), rvec, tvec, camera_matrix, scene.projected.data());
+        return;
+    }
+    projectFast(scene.vertices.data(), (int)scene.vertices.size(), rvec, tvec, camera_matrix, dist_coeff, scene.projected);
+}
+
+
+void drawScene(cv::Mat &frame, const Scene &scene) {
+    const cv::Point2f *p = scene.projected.data();
+    const int *e = scene.edges.data();
+    for (const SceneBatch &batch : scene.batches) {
+        int end = batch.firstEdge + batch.numEdges;
+        for (int i = batch.firstEdge; i < end; ++i) {
+            cv::line(frame, p[e[2 * i]], p[e[2 * i + 1]], batch.color, batch.thickness);
+        }
+    }
+}
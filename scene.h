@@ -0,0 +1,50 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: static wireframe scene projected onto the target in one batch
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "primitives.h"
+
+// A run of edges drawn with the same colour and line thickness
+struct SceneBatch {
+    int firstEdge;
+    int numEdges;
+    cv::Scalar color;
+    int thickness;
+};
+
+// All objects of the scene, built once at startup.
+// Vertices of every object share one buffer, edges index into it
+// (edges[2 * e], edges[2 * e + 1]) and batches group edges by style.
+struct Scene {
+    std::vector<cv::Point3f> vertices;
+    std::vector<int> edges;
+    std::vector<SceneBatch> batches;
+
+    // Image positions of the vertices, rewritten by projectScene() every frame
+    std::vector<cv::Point2f> projected;
+};
+
+// Append an object; edge indices are local to its points
+void addObject(Scene &scene, const std::vector<cv::Point3f> &points, const std::vector<int> &edges,
+               const cv::Scalar &color, int thickness);
+
+// Append a generated shape with its wireframe edges
+void addPrimitive(Scene &scene, const Primitive &prim, const cv::Scalar &color, int thickness);
+
+// Hexagonal prism, the two cubes attached to it and the football.
+// detail is the number of segments around curved objects (the level of detail).
+void buildDemoScene(Scene &scene, int detail = 20);
+
+// One projectPoints call for the whole vertex buffer, or the pinhole kernel when there is
+// no distortion (frames undistorted up front)
+void projectScene(Scene &scene, const cv::Mat &rvec, const cv::Mat &tvec,
+                  const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff);
+
+// One pass over the edge list
+void drawScene(cv::Mat &frame, const Scene &scene);
+
+#endif
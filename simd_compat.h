@@ -0,0 +1,29 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: OpenCV universal intrinsics under the names current versions use
+
+#ifndef SIMD_COMPAT_H
+#define SIMD_COMPAT_H
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+// OpenCV 4.6 added VTraits<>::vlanes() and function forms of the vector operators
+// (v_add, v_mul, v_gt, ...), the only spelling the scalable backends have; nlanes and the
+// operators are deprecated since. Older versions get the function forms here.
+#if CV_SIMD && CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR < 6
+namespace cv {
+template <typename T>
+struct VTraits {
+    static int vlanes() { return T::nlanes; }
+};
+
+inline v_float32 v_add(const v_float32 &a, const v_float32 &b) { return a + b; }
+inline v_float32 v_mul(const v_float32 &a, const v_float32 &b) { return a * b; }
+inline v_float32 v_div(const v_float32 &a, const v_float32 &b) { return a / b; }
+inline v_float32 v_gt(const v_float32 &a, const v_float32 &b) { return a > b; }
+inline v_float32 v_ge(const v_float32 &a, const v_float32 &b) { return a >= b; }
+inline v_float32 v_and(const v_float32 &a, const v_float32 &b) { return a & b; }
+}
+#endif
+
+#endif
@@ -0,0 +1,465 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: several camera streams served by one shared pool of detection/pose workers
+
+#include "stream_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <opencv2/core/utils/filesystem.hpp>
+#include "calib_store.h"
+#include "work_pool.h"
+
+// Back off while there is no work: spin briefly, then sleep
+static void idle(int &spins) {
+    if (++spins < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+
+// Sleep up to `seconds`, waking early when the stream is told to stop or restart
+static void waitForStream(StreamServer &server, Stream &stream, double seconds) {
+    double until = pipelineClock() + seconds;
+    while (!server.stopping && !stream.stopRequested && !stream.restartRequested && pipelineClock() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
+
+
+const char *streamStateName(int state) {
+    switch (state) {
+    case STREAM_OPENING: return "opening";
+    case STREAM_RUNNING: return "running";
+    case STREAM_RESTARTING: return "restarting";
+    case STREAM_STOPPED: return "stopped";
+    }
+    return "?";
+}
+
+
+void addStream(StreamServer &server, const StreamConfig &config) {
+    std::unique_ptr<Stream> stream(new Stream);
+    stream->config = config;
+
+    // IDs name files and metrics, so two streams never share one
+    std::string id = config.id.empty() ? cameraIdFor(config.input) : config.id;
+    std::string unique = id;
+    for (int n = 2;; ++n) {
+        bool taken = false;
+        for (const std::unique_ptr<Stream> &other : server.streams) {
+            taken = taken || other->config.id == unique;
+        }
+        if (!taken) {
+            break;
+        }
+        unique = id + "_" + std::to_string(n);
+    }
+    stream->config.id = unique;
+
+    // World coordinates of the inner corners, one square apart
+    for (int i = 0; i < config.boardSize.height; ++i) {
+        for (int j = 0; j < config.boardSize.width; ++j) {
+            stream->point_set.push_back(cv::Vec3f(j * config.squareSize, -i * config.squareSize, 0.0f));
+        }
+    }
+    if (config.lod > 0) {
+        buildDemoScene(stream->scene, config.lod);
+    }
+    stream->tracker.boardSize = config.boardSize;
+    stream->tracker.mode = server.detectMode;
+
+    stream->detectStage = metricStage((unique + ".detect").c_str());
+    stream->poseStage = metricStage((unique + ".pose").c_str());
+    stream->frameStage = metricStage((unique + ".frame").c_str());
+    server.streams.push_back(std::move(stream));
+}
+
+
+// Open the source and load the calibration for the resolution it delivers
+static bool openStream(StreamServer &server, Stream &stream) {
+    if (!openFrameSource(stream.config.input, stream.source)) {
+        return false;
+    }
+    cv::Size size = frameSourceSize(stream.source);
+    if (size.area() == 0) {
+        return false;
+    }
+
+    cv::Mat camera_matrix = cv::Mat::eye(3, 3, CV_64F);
+    camera_matrix.at<double>(0, 2) = size.width / 2;
+    camera_matrix.at<double>(1, 2) = size.height / 2;
+    std::vector<double> distortion_coefficients;
+
+    const std::string &id = stream.config.id;
+    std::string path = stream.config.calibrationFile.empty() ? calibrationPath(server.calibrationDir, id, size)
+                                                              : stream.config.calibrationFile;
+    StoredCalibration stored;
+    if (loadCalibration(path, size, stored)) {
+        camera_matrix = stored.camera_matrix;
+        distortion_coefficients = stored.distortion_coefficients;
+        printf("%s: %dx%d, calibration %s (%.3f px RMS)\n", id.c_str(), size.width, size.height, path.c_str(), stored.error);
+    } else {
+        printf("%s: %dx%d, no calibration at %s, poses are uncalibrated\n", id.c_str(), size.width, size.height, path.c_str());
+    }
+    storeIntrinsics(stream.intrinsics, makeIntrinsics(camera_matrix, distortion_coefficients));
+    return true;
+}
+
+
+// Whether the capture thread may end. A restart asked for while it was on its way out reopens
+// the source instead; restartStream() decides under the same lock whether to leave the
+// restart to this thread or start a new one.
+static bool finishCapture(StreamServer &server, Stream &stream) {
+    std::lock_guard<std::mutex> lock(stream.exitMutex);
+    if (stream.restartRequested && !server.stopping && !stream.stopRequested) {
+        return false;
+    }
+    stream.state = STREAM_STOPPED;
+    stream.captureDone = true;
+    return true;
+}
+
+
+// Reads one stream into its queue, reopening the source when it fails or ends
+static void captureLoop(StreamServer &server, Stream &stream) {
+    StageHistogram *captureStage = metricStage((stream.config.id + ".capture").c_str());
+    const char *id = stream.config.id.c_str();
+    double delay = server.restartDelay;
+    bool opened = false;
+    uint64_t framesRead = 0;
+    double nextFrameTime = 0;
+    FramePacket packet, oldest;
+
+    while (!server.stopping && !stream.stopRequested) {
+        if (stream.restartRequested.exchange(false)) {
+            // Like a new capture thread: the source from the start, with a full --max-frames
+            opened = false;
+            framesRead = 0;
+        }
+        if (!opened) {
+            if (!openStream(server, stream)) {
+                printf("%s: cannot open %s, retrying in %.0f s\n", id, stream.config.input.c_str(), delay);
+                stream.state = STREAM_RESTARTING;
+                waitForStream(server, stream, delay);
+                delay = std::min(delay * 2, 30.0);
+                continue;
+            }
+            opened = true;
+            stream.resetTracking = true;
+            stream.state = STREAM_RUNNING;
+        }
+        if (server.maxFrames > 0 && framesRead >= (uint64_t)server.maxFrames) {
+            if (finishCapture(server, stream)) {
+                return;
+            }
+            continue;
+        }
+
+        stream.recycled.tryPop(packet);
+        bool ok;
+        {
+            ScopedTimer timer(captureStage);
+            ok = readFrame(stream.source, packet.frame) && !packet.frame.empty();
+        }
+        if (!ok) {
+            if (!stream.source.live && !server.loop) {
+                if (finishCapture(server, stream)) {
+                    return;
+                }
+                continue;
+            }
+            // A camera that dropped out is reopened with a growing delay, a looped recording at once
+            opened = false;
+            stream.restarts++;
+            stream.state = STREAM_RESTARTING;
+            if (stream.source.live) {
+                printf("%s: camera lost, reopening in %.0f s\n", id, delay);
+                waitForStream(server, stream, delay);
+                delay = std::min(delay * 2, 30.0);
+            }
+            continue;
+        }
+        delay = server.restartDelay;
+        framesRead++;
+
+        // Paced recordings stand in for cameras: frames arrive at a fixed rate whether or not
+        // the workers keep up
+        bool paced = server.paceFps > 0 && !stream.source.live;
+        if (paced) {
+            double now = pipelineClock();
+            if (nextFrameTime > now) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(nextFrameTime - now));
+            }
+            nextFrameTime = std::max(now, nextFrameTime) + 1.0 / server.paceFps;
+        }
+
+        packet.captureTime = pipelineClock();
+        packet.seq = stream.nextSeq++;
+        stream.framesCaptured++;
+        if (stream.source.live || paced) {
+            // Live: drop the oldest queued frame rather than fall behind
+            while (!stream.queue.tryPush(packet)) {
+                if (stream.queue.tryPop(oldest)) {
+                    stream.recycled.tryPush(oldest);
+                    stream.framesDropped++;
+                }
+            }
+        } else {
+            int spins = 0;
+            while (!stream.queue.tryPush(packet) && !server.stopping && !stream.stopRequested) {
+                idle(spins);
+            }
+        }
+    }
+    finishCapture(server, stream);
+}
+
+
+static void writeOutput(StreamServer &server, Stream &stream, FramePacket &packet) {
+    if (stream.poseLog) {
+        double r[3] = {0, 0, 0}, t[3] = {0, 0, 0};
+        if (packet.found) {
+            for (int i = 0; i < 3; ++i) {
+                r[i] = packet.rvec.at<double>(i);
+                t[i] = packet.tvec.at<double>(i);
+            }
+        }
+        fprintf(stream.poseLog, "%llu,%.6f,%d,%s,%.4f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", (unsigned long long)packet.seq,
+                packet.captureTime - server.startTime, packet.found ? 1 : 0, detectSourceName(packet.source),
+                packet.reprojectionError, r[0], r[1], r[2], t[0], t[1], t[2]);
+    }
+    if (server.saveFrames && !server.outputDir.empty()) {
+        if (packet.found && !stream.scene.vertices.empty()) {
+            projectScene(stream.scene, packet.rvec, packet.tvec, packet.intrinsics->camera_matrix,
+                         packet.intrinsics->distortion_coefficients);
+            drawScene(packet.frame, stream.scene);
+        }
+        char name[1024];
+        snprintf(name, sizeof(name), "%s/%s/frame_%06llu.png", server.outputDir.c_str(), stream.config.id.c_str(),
+                 (unsigned long long)packet.seq);
+        cv::imwrite(name, packet.frame);
+    }
+}
+
+
+// Detection, pose and output for one frame; the caller holds the stream's claim
+static void processFrame(StreamServer &server, Stream &stream, FramePacket &packet) {
+    if (stream.resetTracking.exchange(false)) {
+        resetBoardTracker(stream.tracker);
+        resetPose(stream.pose);
+    }
+    packet.intrinsics = loadIntrinsics(stream.intrinsics);
+    const cv::Mat &camera_matrix = packet.intrinsics->camera_matrix;
+    const std::vector<double> &distortion_coefficients = packet.intrinsics->distortion_coefficients;
+
+    cv::cvtColor(packet.frame, stream.gray, cv::COLOR_BGR2GRAY);
+    {
+        ScopedTimer timer(stream.detectStage);
+        packet.found = detectBoard(stream.tracker, stream.gray, packet.corners);
+    }
+    packet.source = stream.tracker.source;
+    packet.detectMs = stream.tracker.detectMs;
+    packet.reprojectionError = 0;
+    if (packet.found) {
+        {
+            ScopedTimer timer(stream.poseStage);
+            packet.found = estimatePose(stream.pose, stream.point_set, packet.corners, camera_matrix,
+                                        distortion_coefficients, packet.rvec, packet.tvec);
+        }
+        packet.reprojectionError = stream.pose.rms;
+        if (packet.found) {
+            predictBoardRegion(stream.tracker, packet.rvec, packet.tvec, camera_matrix, distortion_coefficients,
+                               packet.frame.size());
+            stream.framesFound++;
+        }
+    } else {
+        resetPose(stream.pose);
+    }
+
+    writeOutput(server, stream, packet);
+    recordDuration(stream.frameStage, (pipelineClock() - packet.captureTime) * 1000.0);
+    recordFrame();
+    stream.framesProcessed++;
+    stream.recycled.tryPush(packet);
+}
+
+
+// Take one frame at a time from the streams in turn, starting at a shared cursor so
+// concurrent workers spread over different streams
+static void workerLoop(StreamServer &server) {
+    FramePacket packet;
+    size_t n = server.streams.size();
+    int spins = 0;
+    while (!server.stopping) {
+        bool worked = false;
+        size_t start = server.cursor.fetch_add(1, std::memory_order_relaxed);
+        for (size_t k = 0; k < n && !worked; ++k) {
+            Stream &stream = *server.streams[(start + k) % n];
+            if (stream.queue.empty()) {
+                continue;
+            }
+            bool expected = false;
+            if (!stream.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                continue;   // another worker has this stream's previous frame
+            }
+            if (stream.queue.tryPop(packet)) {
+                processFrame(server, stream, packet);
+                worked = true;
+            }
+            stream.claimed.store(false, std::memory_order_release);
+        }
+
+        if (worked) {
+            spins = 0;
+        } else if (!serverRunning(server)) {
+            break;
+        } else {
+            idle(spins);
+        }
+    }
+    server.runningWorkers--;
+}
+
+
+void startServer(StreamServer &server) {
+    server.startTime = pipelineClock();
+    for (std::unique_ptr<Stream> &stream : server.streams) {
+        if (!server.outputDir.empty()) {
+            std::string dir = cv::utils::fs::join(server.outputDir, stream->config.id);
+            cv::utils::fs::createDirectories(dir);
+            std::string logFilename = cv::utils::fs::join(dir, "poses.csv");
+            stream->poseLog = fopen(logFilename.c_str(), "w");
+            if (!stream->poseLog) {
+                std::cerr << "Error: Could not write " << logFilename << std::endl;
+            } else {
+                fprintf(stream->poseLog, "frame,time,found,source,rms,rx,ry,rz,tx,ty,tz\n");
+            }
+        }
+        stream->captureThread = std::thread(captureLoop, std::ref(server), std::ref(*stream));
+    }
+
+    int workers = server.workers > 0 ? server.workers : defaultThreadCount();
+    server.runningWorkers = workers;
+    for (int i = 0; i < workers; ++i) {
+        server.threads.emplace_back(workerLoop, std::ref(server));
+    }
+}
+
+
+bool serverRunning(const StreamServer &server) {
+    for (const std::unique_ptr<Stream> &stream : server.streams) {
+        if (!stream->captureDone || !stream->queue.empty() || stream->claimed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static Stream *findStream(StreamServer &server, const std::string &id) {
+    for (std::unique_ptr<Stream> &stream : server.streams) {
+        if (stream->config.id == id) {
+            return stream.get();
+        }
+    }
+    return nullptr;
+}
+
+
+bool restartStream(StreamServer &server, const std::string &id) {
+    std::lock_guard<std::mutex> lock(server.controlMutex);
+    Stream *stream = findStream(server, id);
+    if (!stream || server.stopping) {
+        return false;
+    }
+    stream->restarts++;
+    {
+        // Under the exit lock the capture thread either has not decided to end, and then
+        // reopens the source before its next frame or on its way out, or has already ended
+        std::lock_guard<std::mutex> exitLock(stream->exitMutex);
+        if (!stream->captureDone) {
+            stream->state = STREAM_RESTARTING;
+            stream->restartRequested = true;
+            return true;
+        }
+    }
+
+    // The stream had ended: run a new capture thread for it
+    if (stream->captureThread.joinable()) {
+        stream->captureThread.join();
+    }
+    stream->stopRequested = false;
+    stream->restartRequested = false;
+    stream->state = STREAM_RESTARTING;
+    stream->captureDone = false;
+    stream->captureThread = std::thread(captureLoop, std::ref(server), std::ref(*stream));
+    return true;
+}
+
+
+bool stopStream(StreamServer &server, const std::string &id) {
+    std::lock_guard<std::mutex> lock(server.controlMutex);
+    Stream *stream = findStream(server, id);
+    if (!stream || server.stopping) {
+        return false;
+    }
+    stream->stopRequested = true;
+    return true;
+}
+
+
+void stopServer(StreamServer &server) {
+    {
+        std::lock_guard<std::mutex> lock(server.controlMutex);
+        server.stopping = true;
+        for (std::unique_ptr<Stream> &stream : server.streams) {
+            if (stream->captureThread.joinable()) {
+                stream->captureThread.join();
+            }
+        }
+    }
+    for (std::thread &thread : server.threads) {
+        thread.join();
+    }
+    server.threads.clear();
+    for (std::unique_ptr<Stream> &stream : server.streams) {
+        if (stream->poseLog) {
+            fclose(stream->poseLog);
+            stream->poseLog = nullptr;
+        }
+    }
+}
+
+
+void printStreamStatus(const StreamServer &server, bool toLogger) {
+    double elapsed = pipelineClock() - server.startTime;
+    uint64_t total = 0;
+    char line[logLineSize];
+    for (const std::unique_ptr<Stream> &stream : server.streams) {
+        uint64_t processed = stream->framesProcessed;
+        total += processed;
+        snprintf(line, sizeof(line),
+                 "%-16s %-10s captured %6llu processed %6llu dropped %5llu found %3.0f%% restarts %d  %6.1f FPS"
+                 "  detect p50 %6.2f ms  frame p95 %7.2f ms\n",
+                 stream->config.id.c_str(), streamStateName(stream->state), (unsigned long long)stream->framesCaptured,
+                 (unsigned long long)processed, (unsigned long long)stream->framesDropped,
+                 processed ? 100.0 * stream->framesFound / processed : 0.0, (int)stream->restarts,
+                 elapsed > 0 ? processed / elapsed : 0.0, stagePercentile(stream->detectStage, 50),
+                 stagePercentile(stream->frameStage, 95));
+        if (toLogger) {
+            logLine(line);
+        } else {
+            fputs(line, stdout);
+        }
+    }
+    snprintf(line, sizeof(line), "%d streams: %.1f FPS in total over %.1f s\n", (int)server.streams.size(),
+             elapsed > 0 ? total / elapsed : 0.0, elapsed);
+    if (toLogger) {
+        logLine(line);
+    } else {
+        fputs(line, stdout);
+    }
+}
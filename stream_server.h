@@ -0,0 +1,125 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: several camera streams served by one shared pool of detection/pose workers
+
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "board_tracker.h"
+#include "frame_source.h"
+#include "intrinsics.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "pose_tracker.h"
+#include "ring_queue.h"
+#include "scene.h"
+
+// What one stream looks at and how it is calibrated
+struct StreamConfig {
+    std::string id;                // name in logs, metrics and output paths; derived from input when empty
+    std::string input;             // FrameSource spec: camera index, video, directory or glob
+    std::string calibrationFile;   // empty: the store entry for id at the stream's resolution
+    cv::Size boardSize = cv::Size(6, 9);
+    float squareSize = 1.0f;       // world units per board square
+    int lod = 20;                  // detail of the demo scene, 0 draws no scene
+};
+
+enum StreamState {
+    STREAM_OPENING,
+    STREAM_RUNNING,
+    STREAM_RESTARTING,
+    STREAM_STOPPED
+};
+
+// One camera: its own source, calibration, board, scene and tracking state. A capture
+// thread per stream reads frames into the stream's queue; the shared workers take them
+// from there, one frame at a time and never two frames of one stream at once, so tracking
+// state needs no lock and frames are processed in order.
+struct Stream {
+    StreamConfig config;
+    FrameSource source;
+    IntrinsicsPtr intrinsics;
+    std::vector<cv::Vec3f> point_set;
+    Scene scene;
+    BoardTracker tracker;
+    PoseTracker pose;
+    cv::Mat gray;
+    FILE *poseLog = nullptr;
+
+    RingQueue<FramePacket> queue{4};      // captured frames waiting for a worker
+    RingQueue<FramePacket> recycled{8};   // processed packets, their buffers carry the next frames
+    std::thread captureThread;
+    std::atomic<bool> claimed{false};     // a worker is processing one of this stream's frames
+    std::atomic<bool> captureDone{false};
+    std::atomic<bool> restartRequested{false};
+    std::mutex exitMutex;                 // the capture thread ending against restartStream()
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> resetTracking{false};
+    std::atomic<int> state{STREAM_OPENING};
+    uint64_t nextSeq = 0;
+
+    // Per-stream statistics
+    std::atomic<uint64_t> framesCaptured{0};
+    std::atomic<uint64_t> framesProcessed{0};
+    std::atomic<uint64_t> framesDropped{0};
+    std::atomic<uint64_t> framesFound{0};
+    std::atomic<int> restarts{0};
+    StageHistogram *detectStage = nullptr;
+    StageHistogram *poseStage = nullptr;
+    StageHistogram *frameStage = nullptr;   // capture to processed, including queueing
+};
+
+// The streams and the worker pool shared by all of them. Idle workers go round the
+// streams from a shared cursor and take one frame from the next stream that has one, so
+// every stream gets its turn however many frames the others have queued. Streams run
+// independently: a stream whose source fails or ends is reopened on its own (a camera
+// always, a recording with `loop`), and restartStream()/stopStream() act on one stream.
+struct StreamServer {
+    std::vector<std::unique_ptr<Stream>> streams;
+    int workers = 0;              // 0 uses every core
+    std::string calibrationDir = "calibration";
+    std::string outputDir;        // per-stream pose logs (and frames with saveFrames), empty writes nothing
+    bool saveFrames = false;      // only with outputDir
+    bool loop = false;            // restart recordings at their end instead of stopping
+    double paceFps = 0;           // read recordings at this rate and drop frames like a camera, 0 reads as fast as processed
+    int maxFrames = 0;            // per stream, 0 for no limit
+    double restartDelay = 1.0;    // seconds before reopening a failed source, doubled per failure up to 30 s
+    DetectMode detectMode = DETECT_ROI;
+
+    std::vector<std::thread> threads;
+    std::mutex controlMutex;      // restartStream()/stopStream() against stopServer(), which joins capture threads
+    std::atomic<size_t> cursor{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<int> runningWorkers{0};
+    double startTime = 0;
+};
+
+// Add a stream before startServer()
+void addStream(StreamServer &server, const StreamConfig &config);
+
+void startServer(StreamServer &server);
+
+// True while any stream still has frames coming or queued
+bool serverRunning(const StreamServer &server);
+
+// Reopen one stream's source and start its tracking over; other streams keep running.
+// Both do nothing and return false once stopServer() has begun.
+bool restartStream(StreamServer &server, const std::string &id);
+bool stopStream(StreamServer &server, const std::string &id);
+
+void stopServer(StreamServer &server);
+
+const char *streamStateName(int state);
+
+// One line per stream: state, frames, FPS, detection rate and latencies
+void printStreamStatus(const StreamServer &server, bool toLogger);
+
+#endif
@@ -0,0 +1,383 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: several chessboards and ArUco marker boards found in one pass and fused into one world frame
+
+#include "target_set.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "alloc_counter.h"
+#include "metrics.h"
+
+// Parse "6x9" into a grid size
+static bool parseGrid(const std::string &text, cv::Size &size, int minimum) {
+    int w = 0, h = 0;
+    if (sscanf(text.c_str(), "%dx%d", &w, &h) != 2 || w < minimum || h < minimum) {
+        return false;
+    }
+    size = cv::Size(w, h);
+    return true;
+}
+
+
+// Corners of a grid of markers, clockwise from the top-left as the detector reports them,
+// with rows going -y like the chessboard's
+static bool addMarkerGrid(TargetSet &set, int targetIndex, cv::Size grid, float size, float separation, int firstId) {
+    Target &target = set.targets[targetIndex];
+    float step = size + separation;
+    for (int r = 0; r < grid.height; ++r) {
+        for (int c = 0; c < grid.width; ++c) {
+            int id = firstId + r * grid.width + c;
+            if (set.markers.count(id)) {
+                std::cerr << "Error: Marker " << id << " of target " << target.id << " is used twice" << std::endl;
+                return false;
+            }
+            set.markers[id] = std::make_pair(targetIndex, (int)target.markerIds.size());
+            target.markerIds.push_back(id);
+            float x = c * step, y = -r * step;
+            target.points.push_back(cv::Vec3f(x, y, 0));
+            target.points.push_back(cv::Vec3f(x + size, y, 0));
+            target.points.push_back(cv::Vec3f(x + size, y - size, 0));
+            target.points.push_back(cv::Vec3f(x, y - size, 0));
+        }
+    }
+    return true;
+}
+
+
+bool loadTargetSet(const std::string &path, TargetSet &set) {
+    cv::FileStorage fs;
+    try {
+        if (!fs.open(path, cv::FileStorage::READ)) {
+            return false;
+        }
+    } catch (const cv::Exception &) {
+        return false;
+    }
+    if (!fs["dictionary"].empty()) {
+        set.dictionary = (int)fs["dictionary"];
+    }
+
+    cv::FileNode nodes = fs["targets"];
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        cv::FileNode node = nodes[(int)i];
+        int index = (int)set.targets.size();
+        set.targets.push_back(Target());
+        Target &target = set.targets.back();
+        target.id = node["id"].empty() ? "target" + std::to_string(i) : (std::string)node["id"];
+
+        std::string type = (std::string)node["type"];
+        if (type == "markers") {
+#if !HAVE_ARUCO_DETECTOR
+            std::cerr << "Error: Marker target " << target.id << " needs OpenCV 4.7 or later (built with "
+                      << CV_VERSION << ")" << std::endl;
+            return false;
+#endif
+            target.kind = TARGET_MARKERS;
+            cv::Size grid(1, 1);
+            if (!node["grid"].empty() && !parseGrid((std::string)node["grid"], grid, 1)) {
+                std::cerr << "Error: Bad marker grid for target " << target.id << std::endl;
+                return false;
+            }
+            float size = node["marker_size"].empty() ? 1.0f : (float)node["marker_size"];
+            float separation = node["separation"].empty() ? 0.2f * size : (float)node["separation"];
+            int firstId = node["first_id"].empty() ? 0 : (int)node["first_id"];
+            if (!addMarkerGrid(set, index, grid, size, separation, firstId)) {
+                return false;
+            }
+            set.hasMarkers = true;
+        } else if (type.empty() || type == "chessboard") {
+            target.kind = TARGET_CHESSBOARD;
+            target.boardSize = cv::Size(6, 9);
+            if (!node["board"].empty() && !parseGrid((std::string)node["board"], target.boardSize, 2)) {
+                std::cerr << "Error: Bad board size for target " << target.id << std::endl;
+                return false;
+            }
+            // findChessboardCorners cannot tell two boards of one size apart, nor a board from its
+            // transpose, so each would also be found on the other
+            for (int other = 0; other < index; ++other) {
+                const Target &previous = set.targets[other];
+                if (previous.kind == TARGET_CHESSBOARD &&
+                    (previous.boardSize == target.boardSize ||
+                     previous.boardSize == cv::Size(target.boardSize.height, target.boardSize.width))) {
+                    std::cerr << "Error: Chessboard targets " << previous.id << " and " << target.id << " have the same size "
+                              << target.boardSize.width << "x" << target.boardSize.height << std::endl;
+                    return false;
+                }
+            }
+            float square = node["square_size"].empty() ? 1.0f : (float)node["square_size"];
+            for (int r = 0; r < target.boardSize.height; ++r) {
+                for (int c = 0; c < target.boardSize.width; ++c) {
+                    target.points.push_back(cv::Vec3f(c * square, -r * square, 0));
+                }
+            }
+            set.hasChessboards = true;
+        } else {
+            std::cerr << "Error: Unknown type " << type << " of target " << target.id << std::endl;
+            return false;
+        }
+
+        // Placement in the world: rvec then tvec
+        cv::FileNode world = node["world"];
+        set.placed.push_back(false);
+        set.rotation.push_back(cv::Matx33d::eye());
+        set.translation.push_back(cv::Vec3d(0, 0, 0));
+        if (!world.empty()) {
+            if (world.size() != 6) {
+                std::cerr << "Error: world of target " << target.id << " needs 6 numbers" << std::endl;
+                return false;
+            }
+            cv::Vec3d r((double)world[0], (double)world[1], (double)world[2]);
+            cv::Rodrigues(r, set.rotation.back());
+            set.translation.back() = cv::Vec3d((double)world[3], (double)world[4], (double)world[5]);
+            set.placed.back() = true;
+        }
+    }
+    if (set.targets.empty()) {
+        return false;
+    }
+    // Without a placement the first target is the world frame
+    set.placed[0] = true;
+    set.placedInFile = set.placed;
+    return true;
+}
+
+
+void resetPlacements(TargetSet &set) {
+    std::lock_guard<std::mutex> lock(set.mutex);
+    set.placed = set.placedInFile;
+}
+
+
+void initTargetTracker(TargetTracker &tracker, const TargetSet &set, const BoardTracker &board, const PoseTracker &pose) {
+    int count = (int)set.targets.size();
+    tracker.boards.assign(count, board);
+    tracker.poses.assign(count, pose);
+    tracker.views.assign(count, TargetView());
+    for (int i = 0; i < count; ++i) {
+        BoardTracker &boardTracker = tracker.boards[i];
+        boardTracker.boardSize = set.targets[i].boardSize;
+        // Near the last position first, then the shared level; never a full-resolution search per board
+        boardTracker.mode = DETECT_ROI;
+        boardTracker.scaledSearch = true;
+        boardTracker.fullSearch = false;
+        boardTracker.sharedLevel = &tracker.searchLevel;
+    }
+
+#if HAVE_ARUCO_DETECTOR
+    // Corners refined by the detector, once for all markers
+    cv::aruco::DetectorParameters parameters;
+    parameters.cornerRefinementMethod = cv::aruco::CORNER_REFINE_SUBPIX;
+    tracker.detector = cv::aruco::ArucoDetector(cv::aruco::getPredefinedDictionary(set.dictionary), parameters);
+#endif
+
+    startWorkPool(tracker.pool, tracker.threads);
+    tracker.visible.reserve(count);
+    tracker.placed.resize(count);
+    tracker.rotation.resize(count);
+    tracker.translation.resize(count);
+}
+
+
+// World -> camera from a target's pose and the target's place in the world
+static void cameraFromWorld(const TargetView &view, const cv::Matx33d &worldRotation, const cv::Vec3d &worldTranslation,
+                            cv::Matx33d &R, cv::Vec3d &t) {
+    cv::Matx33d Rc;
+    {
+        LibraryScope library;
+        cv::Rodrigues(view.rvec, Rc);
+    }
+    cv::Vec3d tc(view.tvec.at<double>(0), view.tvec.at<double>(1), view.tvec.at<double>(2));
+    R = Rc * worldRotation.t();
+    t = tc - R * worldTranslation;
+}
+
+
+static double rotationAngle(const cv::Matx33d &R) {
+    double c = (R(0, 0) + R(1, 1) + R(2, 2) - 1) / 2;
+    return std::acos(std::min(1.0, std::max(-1.0, c)));
+}
+
+
+bool detectTargets(TargetTracker &tracker, TargetSet &set, const cv::Mat &gray, const cv::Mat &camera_matrix,
+                   const std::vector<double> &dist_coeff, cv::Mat &rvec, cv::Mat &tvec) {
+    static StageHistogram *targetPoseStage = metricStage("target_pose");
+    static StageHistogram *fuseStage = metricStage("fuse");
+    int count = (int)set.targets.size();
+    for (TargetView &view : tracker.views) {
+        view.found = false;
+        view.image.clear();
+        view.object.clear();
+    }
+
+    // One downscaled level that every chessboard is searched on
+    if (set.hasChessboards) {
+        int levels = 0;
+        while ((gray.cols >> levels) > tracker.maxSearchWidth) {
+            ++levels;
+        }
+        if (levels == 0) {
+            tracker.searchLevel = gray;
+        } else {
+            OutputScope output(tracker.searchLevel);
+            cv::resize(gray, tracker.searchLevel, cv::Size(gray.cols >> levels, gray.rows >> levels), 0, 0, cv::INTER_AREA);
+        }
+    }
+
+#if HAVE_ARUCO_DETECTOR
+    // Every marker of every target in one pass, sorted to their targets by id
+    static StageHistogram *markerStage = metricStage("markers");
+    if (set.hasMarkers) {
+        ScopedTimer timer(markerStage);
+        {
+            LibraryScope library;
+            tracker.detector.detectMarkers(gray, tracker.markerCorners, tracker.markerIds);
+        }
+        for (size_t k = 0; k < tracker.markerIds.size(); ++k) {
+            auto it = set.markers.find(tracker.markerIds[k]);
+            if (it == set.markers.end()) {
+                continue;
+            }
+            const Target &target = set.targets[it->second.first];
+            TargetView &view = tracker.views[it->second.first];
+            for (int c = 0; c < 4; ++c) {
+                view.image.push_back(tracker.markerCorners[k][c]);
+                view.object.push_back(target.points[4 * it->second.second + c]);
+            }
+        }
+    }
+#endif
+
+    // Chessboard searches and the pose of every target are independent, one task each
+    tracker.visible.clear();
+    for (int i = 0; i < count; ++i) {
+        if (set.targets[i].kind == TARGET_CHESSBOARD || !tracker.views[i].image.empty()) {
+            tracker.visible.push_back(i);
+        } else {
+            resetPose(tracker.poses[i]);
+        }
+    }
+    auto solve = [&](int task, int) {
+        int i = tracker.visible[task];
+        TargetView &view = tracker.views[i];
+        if (set.targets[i].kind == TARGET_CHESSBOARD) {
+            if (!detectBoard(tracker.boards[i], gray, view.image)) {
+                resetPose(tracker.poses[i]);
+                return;
+            }
+            view.object = set.targets[i].points;
+        }
+        view.found = estimatePose(tracker.poses[i], view.object, view.image, camera_matrix, dist_coeff, view.rvec, view.tvec);
+        if (view.found && set.targets[i].kind == TARGET_CHESSBOARD) {
+            predictBoardRegion(tracker.boards[i], view.rvec, view.tvec, camera_matrix, dist_coeff, gray.size());
+        }
+    };
+    {
+        ScopedTimer timer(targetPoseStage);
+        if (tracker.visible.size() > 1) {
+            parallelForStealing(tracker.pool, (int)tracker.visible.size(), solve);
+        } else if (!tracker.visible.empty()) {
+            solve(0, 0);
+        }
+    }
+
+    ScopedTimer timer(fuseStage);
+    {
+        std::lock_guard<std::mutex> lock(set.mutex);
+        tracker.placed = set.placed;
+        tracker.rotation = set.rotation;
+        tracker.translation = set.translation;
+    }
+
+    // The placed target with the most points sets the starting pose
+    int reference = -1;
+    tracker.targetsFound = tracker.targetsFused = 0;
+    tracker.rms = 0;
+    for (int i = 0; i < count; ++i) {
+        if (!tracker.views[i].found) {
+            continue;
+        }
+        tracker.targetsFound++;
+        if (tracker.placed[i] && (reference < 0 || tracker.views[i].image.size() > tracker.views[reference].image.size())) {
+            reference = i;
+        }
+    }
+    if (reference < 0) {
+        return false;
+    }
+    cv::Matx33d Rw;
+    cv::Vec3d tw;
+    cameraFromWorld(tracker.views[reference], tracker.rotation[reference], tracker.translation[reference], Rw, tw);
+
+    // Every placed target that agrees with it adds its points in world coordinates
+    tracker.worldObject.clear();
+    tracker.worldImage.clear();
+    double distance = std::max(cv::norm(tw), 1e-6);
+    for (int i = 0; i < count; ++i) {
+        const TargetView &view = tracker.views[i];
+        if (!view.found || !tracker.placed[i]) {
+            continue;
+        }
+        if (i != reference) {
+            cv::Matx33d R;
+            cv::Vec3d t;
+            cameraFromWorld(view, tracker.rotation[i], tracker.translation[i], R, t);
+            if (rotationAngle(R * Rw.t()) > tracker.maxAngle || cv::norm(t - tw) > tracker.maxOffset * distance) {
+                continue;
+            }
+        }
+        tracker.targetsFused++;
+        for (size_t p = 0; p < view.object.size(); ++p) {
+            cv::Vec3d X = tracker.rotation[i] * cv::Vec3d(view.object[p][0], view.object[p][1], view.object[p][2]) + tracker.translation[i];
+            tracker.worldObject.push_back(cv::Vec3f((float)X[0], (float)X[1], (float)X[2]));
+            tracker.worldImage.push_back(view.image[p]);
+        }
+    }
+
+    // One refinement over all of them
+    rvec.create(3, 1, CV_64F);
+    tvec.create(3, 1, CV_64F);
+    {
+        LibraryScope library;
+        cv::Rodrigues(Rw, rvec);
+        for (int k = 0; k < 3; ++k) {
+            tvec.at<double>(k) = tw[k];
+        }
+        if (tracker.targetsFused > 1) {
+            cv::solvePnPRefineLM(tracker.worldObject, tracker.worldImage, camera_matrix, dist_coeff, rvec, tvec);
+        }
+    }
+    tracker.rms = reprojectionRms(tracker.worldObject, tracker.worldImage, rvec, tvec, camera_matrix, dist_coeff, tracker.reprojected);
+
+    // Targets seen for the first time next to placed ones get their place from the fused pose
+    cv::Matx33d R;
+    {
+        LibraryScope library;
+        cv::Rodrigues(rvec, R);
+    }
+    cv::Vec3d t(tvec.at<double>(0), tvec.at<double>(1), tvec.at<double>(2));
+    for (int i = 0; i < count; ++i) {
+        const TargetView &view = tracker.views[i];
+        if (!view.found || tracker.placed[i]) {
+            continue;
+        }
+        cv::Matx33d Rc;
+        {
+            LibraryScope library;
+            cv::Rodrigues(view.rvec, Rc);
+        }
+        cv::Vec3d tc(view.tvec.at<double>(0), view.tvec.at<double>(1), view.tvec.at<double>(2));
+        std::lock_guard<std::mutex> lock(set.mutex);
+        if (!set.placed[i]) {
+            set.rotation[i] = R.t() * Rc;
+            set.translation[i] = R.t() * (tc - t);
+            set.placed[i] = true;
+            char line[logLineSize];
+            snprintf(line, sizeof(line), "Target %s placed at (%.2f, %.2f, %.2f) in the world frame\n", set.targets[i].id.c_str(),
+                     set.translation[i][0], set.translation[i][1], set.translation[i][2]);
+            logLine(line);
+        }
+    }
+    return true;
+}
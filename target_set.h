@@ -0,0 +1,122 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: several chessboards and ArUco marker boards found in one pass and fused into one world frame
+
+#ifndef TARGET_SET_H
+#define TARGET_SET_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "board_tracker.h"
+#include "pose_tracker.h"
+#include "work_pool.h"
+
+// Marker targets use the ArUco detector that objdetect has had since OpenCV 4.7. Older builds
+// track chessboard targets only and refuse marker targets when the file is loaded.
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 7)
+#define HAVE_ARUCO_DETECTOR 1
+#include <opencv2/objdetect/aruco_detector.hpp>
+#else
+#define HAVE_ARUCO_DETECTOR 0
+#endif
+
+enum TargetKind {
+    TARGET_CHESSBOARD,
+    TARGET_MARKERS      // a grid of ArUco markers, any of which is enough for a pose
+};
+
+// One rigid target and its points in its own frame
+struct Target {
+    std::string id;
+    TargetKind kind = TARGET_CHESSBOARD;
+    cv::Size boardSize;              // chessboard inner corners
+    std::vector<cv::Vec3f> points;   // chessboard corners in detection order; markers: 4 corners per marker
+    std::vector<int> markerIds;      // markers in the order of points
+};
+
+// Every target and where it sits in the world. The first target is the world frame unless the
+// file places it; a target without a placement is placed the first time it is seen together
+// with a placed one. Shared by the workers, the placements under the mutex.
+struct TargetSet {
+    std::vector<Target> targets;
+    int dictionary = 0;                     // cv::aruco::DICT_4X4_50
+    std::map<int, std::pair<int, int>> markers;   // marker id -> target, marker index
+    bool hasChessboards = false;
+    bool hasMarkers = false;
+
+    std::mutex mutex;
+    std::vector<char> placed;
+    std::vector<cv::Matx33d> rotation;      // target -> world
+    std::vector<cv::Vec3d> translation;
+    std::vector<char> placedInFile;         // placements as loaded, see resetPlacements()
+};
+
+// Targets from a YAML/JSON file:
+//   dictionary: 0        # cv::aruco predefined dictionary, 0 is DICT_4X4_50
+//   targets:
+//     - { id: table, type: chessboard, board: "6x9", square_size: 1.0 }
+//     - { id: wall, type: markers, grid: "3x2", marker_size: 2.0, separation: 0.5, first_id: 0,
+//         world: [0, 0, 0, 10, 0, 0] }
+// world is the target's rvec and tvec in the world frame.
+bool loadTargetSet(const std::string &path, TargetSet &set);
+
+// Forget the placements learned while tracking, back to the ones in the file, so every run
+// over a stream starts from the same world
+void resetPlacements(TargetSet &set);
+
+// One target in one frame
+struct TargetView {
+    bool found = false;
+    std::vector<cv::Point2f> image;
+    std::vector<cv::Vec3f> object;
+    cv::Mat rvec, tvec;   // target -> camera
+};
+
+// Detection and pose state of one pipeline worker
+struct TargetTracker {
+    // Settings
+    int maxSearchWidth = 800;        // chessboards are searched on one shared level at most this wide
+    double maxAngle = 0.1;           // radians; a target whose camera pose disagrees more is left out
+    double maxOffset = 0.1;          // same, as a share of the camera's distance from the world origin
+    int threads = 2;                 // per-target pose threads of this worker, on top of the pipeline's workers
+
+    std::vector<BoardTracker> boards;   // one per target, used by the chessboards
+    std::vector<PoseTracker> poses;     // one per target
+    std::vector<TargetView> views;
+#if HAVE_ARUCO_DETECTOR
+    cv::aruco::ArucoDetector detector;
+#endif
+    WorkPool pool;                      // kept up between frames
+
+    // Scratch reused every frame
+    cv::Mat searchLevel;
+    std::vector<std::vector<cv::Point2f>> markerCorners;
+    std::vector<int> markerIds;
+    std::vector<int> visible;
+    std::vector<char> placed;
+    std::vector<cv::Matx33d> rotation;
+    std::vector<cv::Vec3d> translation;
+    std::vector<cv::Vec3f> worldObject;
+    std::vector<cv::Point2f> worldImage;
+    std::vector<cv::Point2f> reprojected;
+
+    // Result of the last frame
+    int targetsFound = 0;
+    int targetsFused = 0;
+    double rms = 0;
+};
+
+// Per-worker state for a target set, with the board and pose settings copied from the single-board
+// ones. The tracker must not move afterwards, its board trackers point at its search level.
+void initTargetTracker(TargetTracker &tracker, const TargetSet &set, const BoardTracker &board, const PoseTracker &pose);
+
+// Find every target in a grey frame, estimate their poses in parallel and fuse them into the
+// world pose of the camera (world -> camera in rvec, tvec). Markers come from one detection
+// pass over the frame and chessboards are searched on one shared downscaled level. Returns
+// false when no placed target was seen.
+bool detectTargets(TargetTracker &tracker, TargetSet &set, const cv::Mat &gray, const cv::Mat &camera_matrix,
+                   const std::vector<double> &dist_coeff, cv::Mat &rvec, cv::Mat &tvec);
+
+#endif
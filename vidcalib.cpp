@@ -2,409 +2,854 @@
 // CODE: camera calibration and 3d object projection on live feed
 
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/utils/filesystem.hpp>
 #include "ext.h"
+#include "mesh.h"
+#include "scene.h"
+#include "board_tracker.h"
+#include "intrinsics.h"
+#include "pipeline.h"
+#include "calib_worker.h"
+#include "calib_store.h"
+#include "pose_tracker.h"
+#include "metrics.h"
+#include "frame_source.h"
+#include "rectify.h"
+#include "rasterizer.h"
+#include "board_texture.h"
+#include "governor.h"
+#include "camera_model.h"
+#include "target_set.h"
+#include "alloc_counter.h"
 using namespace cv;
 using namespace std;
 
 
-bool readObjFile(const std::string &filename, std::vector<cv::Point3f> &vertices, std::vector<std::vector<int>> &faces) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        return false;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string type;
-        iss >> type;
-        if (type == "v") {
-            float x, y, z;
-            iss >> x >> y >> z;
-            vertices.push_back(cv::Point3f(x, y, z));
-        } else if (type == "f") {
-            std::vector<int> face;
-            int idx;
-            while (iss >> idx) {
-                face.push_back(idx - 1); // OBJ file indices are 1-based, so subtract 1
-                char c;
-                iss >> c; // Skip texture and normal indices
-            }
-            faces.push_back(face);
-        }
-    }
-
-    return true;
-}
+// Buffers drawOnTarget reuses from frame to frame
+struct MeshScratch {
+    std::vector<cv::Point2f> object_points_2d;
+    std::vector<cv::Point> face_points;
+    std::vector<const cv::Point *> pts;
+    std::vector<int> npts;
+};
 
 
-int drawOnTarget(cv::Mat &src, const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff, const cv::Mat &rvec, const cv::Mat &tvec, const std::string &obj_filename) {
-    // Load the OBJ file and read vertices and faces
-    std::vector<cv::Point3f> object_points_3d;
-    std::vector<std::vector<int>> object_faces;
-    if (!readObjFile(obj_filename, object_points_3d, object_faces)) {
-        std::cerr << "Error: Could not read OBJ file " << obj_filename << std::endl;
+int drawOnTarget(cv::Mat &src, const cv::Mat &camera_matrix, const std::vector<double> &dist_coeff, const cv::Mat &rvec, const cv::Mat &tvec, MeshHandle mesh, MeshScratch &scratch) {
+    if (!mesh || mesh->numVertices == 0) {
         return -1;
     }
 
-    // Project 3D points of the object onto the image plane
-    std::vector<cv::Point2f> object_points_2d;
-    cv::projectPoints(object_points_3d, rvec, tvec, camera_matrix, dist_coeff, object_points_2d);
+    // Project 3D points of the object onto the image plane, straight from the cached vertex array
+    std::vector<cv::Point2f> &object_points_2d = scratch.object_points_2d;
+    if (dist_coeff.empty()) {
+        object_points_2d.resize(mesh->numVertices);
+        projectPinhole(mesh->vertices, mesh->numVertices, rvec, tvec, camera_matrix, object_points_2d.data());
+    } else {
+        projectFast(mesh->vertices, mesh->numVertices, rvec, tvec, camera_matrix, dist_coeff, object_points_2d);
+    }
 
-    // Draw the projected object onto the image
-    for (const auto &face : object_faces) {
-        std::vector<cv::Point> points;
-        for (int idx : face) {
-            points.push_back(object_points_2d[idx]);
-        }
-        const cv::Point *pts = (const cv::Point*) cv::Mat(points).data;
-        int npts = cv::Mat(points).rows;
-        cv::polylines(src, &pts, &npts, 1, true, cv::Scalar(0, 255, 255), 2);
+    // Gather the face outlines into one flat array and draw them with a single call
+    std::vector<cv::Point> &face_points = scratch.face_points;
+    face_points.resize(mesh->numIndices);
+    for (int i = 0; i < mesh->numIndices; ++i) {
+        face_points[i] = object_points_2d[mesh->indices[i]];
     }
+    scratch.pts.resize(mesh->numFaces);
+    scratch.npts.resize(mesh->numFaces);
+    for (int f = 0; f < mesh->numFaces; ++f) {
+        scratch.pts[f] = &face_points[mesh->faceOffsets[f]];
+        scratch.npts[f] = mesh->faceOffsets[f + 1] - mesh->faceOffsets[f];
+    }
+    LibraryScope library;
+    cv::polylines(src, scratch.pts.data(), scratch.npts.data(), mesh->numFaces, true, cv::Scalar(0, 255, 255), 2);
 
     return 0;
 }
 
 
 
-int main(int argc, char *argv[]) {
-    cv::VideoCapture *capdev;
-    cv::Mat grey;  // Declare the grey variable
+// Everything the render side needs for one run over a stream of frames
+struct ArSession {
+    std::vector<cv::Vec3f> point_set;  // 3D world positions of the board corners
+    IntrinsicsPtr shared_intrinsics;
+    MeshHandle mesh = nullptr;
+    std::vector<Scene> scenes;                 // one per level of detail the governor can pick, built up front
+    std::vector<int> levelScene;               // scene of each quality level
+    int scene = 0;                             // scene drawn now
+
+    // Settings copied into every worker / run
+    BoardTracker tracker;
+    PoseTracker pose;
+    PoseFilter filter;
+    int threads = 2;
+
+    bool undistort = false;                    // undistort frames once and draw with the pinhole model
+    RectifyCache rectify;
+
+    bool headless = false;                     // no window: nothing is shown and no keys are read
+    std::string outputDir;                     // overlay frames and pose log, empty writes nothing
+    CalibrationWorker *calibrator = nullptr;   // views saved with 's', interactive runs only
+    bool checkAllocations = false;             // fail the run if steady-state frames allocate
+
+    BoardTexture texture;                      // image laid onto the board, no levels when off
+    bool filledMesh = true;                    // filled, depth-tested faces instead of outlines
+    bool predict = true;                       // live input: draw on the newest frame with a predicted pose
+
+    Governor governor;                         // trades detail for frame rate, off without a target FPS
+    bool multiTarget = false;                  // track the targets instead of the single board
+    TargetSet targets;
+    int lod = 20;                              // scene level of detail the governor scales down from
+    MeshRenderer renderer;
+    MeshScratch meshScratch;                   // render-side buffers reused every frame
+};
+
+// Detection and pose state owned by one pipeline worker
+struct FrameWorker {
+    BoardTracker tracker;
+    PoseTracker pose;
+    cv::Mat gray;
+    int quality = -1;   // governor state last applied to the tracker
+    TargetTracker targets;
+};
+
+
+// Detect the board in a captured frame and estimate its pose, runs on a pipeline worker
+void analyzeFrame(FrameWorker &worker, ArSession &session, FramePacket &packet) {
+    static StageHistogram *rectifyStage = metricStage("rectify");
+    countAllocations();
+    const std::vector<cv::Vec3f> &point_set = session.point_set;
+    packet.intrinsics = loadIntrinsics(session.shared_intrinsics);
+    packet.drawIntrinsics = packet.intrinsics;
+    const cv::Mat &camera_matrix = packet.intrinsics->camera_matrix;
+    const std::vector<double> &distortion_coefficients = packet.intrinsics->distortion_coefficients;
+
+    static StageHistogram *grayStage = metricStage("gray");
+    static StageHistogram *poseStage = metricStage("pose");
+
+    // Settings of the governor's current quality level, and whether this frame is searched at all
+    applyQuality(session.governor, session.tracker, worker.tracker, worker.quality);
+    bool search = !skipSearch(session.governor, packet.seq);
 
-    // Open the video device
-    capdev = new cv::VideoCapture(0);
-    if (!capdev->isOpened()) {
-        printf("Unable to open video device\n");
-        return -1;
+    // Convert the image to grayscale
+    if (search) {
+        ScopedTimer timer(grayStage);
+        OutputScope output(worker.gray);
+        cv::cvtColor(packet.frame, worker.gray, cv::COLOR_BGR2GRAY);
     }
 
-    // Get some properties of the image
-    cv::Size refS((int)capdev->get(cv::CAP_PROP_FRAME_WIDTH),
-                  (int)capdev->get(cv::CAP_PROP_FRAME_HEIGHT));
-    printf("Expected size: %d %d\n", refS.width, refS.height);
+    // Detection and pose run on the original frame; only what is shown is undistorted,
+    // with tables built once per calibration
+    if (session.undistort) {
+        ScopedTimer timer(rectifyStage);
+        RectifyMapsPtr maps = rectifyMaps(session.rectify, packet.intrinsics, packet.frame.size());
+        if (!maps->map1.empty()) {
+            // Into the packet's spare buffer, which then becomes the frame
+            {
+                OutputScope output(packet.spare);
+                rectifyFrame(*maps, packet.frame, packet.spare);
+            }
+            std::swap(packet.frame, packet.spare);
+        }
+        packet.drawIntrinsics = maps->rectified;
+    }
 
-    cv::namedWindow("Video", 1); // Identifies a window
-    cv::Mat frame;
-    cv::Mat image = cv::imread("brick.jpeg");
-    std::string obj_filename = "cup.obj";
+    if (!search) {
+        return;
+    }
 
-    // Definitions for calibration
-    std::vector<cv::Vec3f> point_set;  // 3D world positions
-    std::vector<std::vector<cv::Vec3f>> point_list;  // List of 3D world positions
-    std::vector<std::vector<cv::Point2f>> corner_list;  // List of 2D image coordinates
+    // Every target in one pass, fused into one world pose
+    if (session.multiTarget) {
+        int64_t start = cv::getTickCount();
+        packet.found = detectTargets(worker.targets, session.targets, worker.gray, camera_matrix, distortion_coefficients,
+                                     packet.rvec, packet.tvec);
+        packet.detectMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+        packet.source = packet.found ? FOUND_TARGETS : FOUND_NONE;
+        packet.targetsFound = worker.targets.targetsFound;
+        packet.targetsFused = worker.targets.targetsFused;
+        packet.reprojectionError = worker.targets.rms;
+        return;
+    }
 
-    cv::Mat camera_matrix = cv::Mat::eye(3, 3, CV_64F); // Initialize camera matrix
-    camera_matrix.at<double>(0, 2) = refS.width / 2; // Initialize center of the image
-    camera_matrix.at<double>(1, 2) = refS.height / 2;
+    // Find chessboard corners, searching near last frame's board first
+    packet.found = detectBoard(worker.tracker, worker.gray, packet.corners);
+    packet.source = worker.tracker.source;
+    packet.detectMs = worker.tracker.detectMs;
+    if (!packet.found) {
+        resetPose(worker.pose);
+        return;
+    }
 
-    std::vector<double> distortion_coefficients; // Define distortion coefficients
-    std::vector<cv::Mat> rotations, translations;
+    // Estimate the pose of the target board, starting from the last pose while it is tracked
+    {
+        ScopedTimer timer(poseStage);
+        packet.found = estimatePose(worker.pose, point_set, packet.corners, camera_matrix, distortion_coefficients, packet.rvec, packet.tvec);
+    }
+    packet.reprojectionError = worker.pose.rms;
+    packet.fullSolve = worker.pose.fullSolve;
+    packet.poseMs = worker.pose.poseMs;
+    if (!packet.found) {
+        return;
+    }
 
+    // Search next frame where this pose puts the board
+    predictBoardRegion(worker.tracker, packet.rvec, packet.tvec, camera_matrix, distortion_coefficients, packet.frame.size());
+}
 
-    int colorState = 0; // Variable to track color state (if needed)
-    cv::Mat blurred_frame; // New variable to store the blurred frame
 
-    for (;;) {
-        *capdev >> frame; // Get a new frame from the camera, treat as a stream
 
-        if (frame.empty()) {
-            printf("Frame is empty\n");
-            break;
+// Build the scene at every level of detail the quality levels use, so the governor only
+// switches between them and the render loop never rebuilds one
+static void buildScenes(ArSession &session) {
+    std::vector<int> lods;
+    session.scenes.clear();
+    session.levelScene.clear();
+    for (int level = 0; level < qualityLevelCount(); ++level) {
+        int lod = levelLod(level, session.lod);
+        auto found = std::find(lods.begin(), lods.end(), lod);
+        if (found == lods.end()) {
+            lods.push_back(lod);
+            session.scenes.emplace_back();
+            buildDemoScene(session.scenes.back(), lod);
+            found = lods.end() - 1;
         }
+        session.levelScene.push_back((int)(found - lods.begin()));
+    }
+    session.scene = session.levelScene[0];
+}
 
 
-    Mat gray;
-    // Convert the image to grayscale
-    cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
-
-    // Define the chessboard size (rows x columns)
-    cv::Size boardSize(6, 9);
-
-    // Find chessboard corners
-    std::vector<cv::Point2f> framePoints;
-    bool found = cv::findChessboardCorners(gray, boardSize, framePoints);
 
-    // Populate point_set with 3D world coordinates (assuming each square is 1 unit)
-    point_set.clear();
-    for (int i = 0; i < boardSize.height; ++i) {
-        for (int j = 0; j < boardSize.width; ++j) {
-            point_set.push_back(cv::Vec3f(static_cast<float>(j), static_cast<float>(-i), 0.0f));
+// What one run did
+struct RunStats {
+    uint64_t framesShown = 0;
+    uint64_t framesDropped = 0;
+    double seconds = 0;
+
+    // Allocations after the warm-up, with --check-allocations
+    uint64_t steadyFrames = 0;
+    uint64_t ownAllocations = 0;
+    uint64_t libraryAllocations = 0;
+};
+
+// Frames before the allocation check starts counting: packets, buffers and scratch
+// vectors all reach their working size in the first few rounds of the ring
+const uint64_t allocationWarmupFrames = 60;
+
+
+// Run capture -> detection/pose -> render until the stream ends or 'q' is pressed
+static void runSession(ArSession &session, const CaptureStage &capture, bool dropFrames, RunStats &stats) {
+    static StageHistogram *projectStage = metricStage("project");
+    static StageHistogram *drawStage = metricStage("draw");
+    static StageHistogram *rasterStage = metricStage("raster");
+    static StageHistogram *textureStage = metricStage("texture");
+    static StageHistogram *displayStage = metricStage("display");
+    static StageHistogram *outputStage = metricStage("output");
+    static StageHistogram *frameStage = metricStage("frame");
+    static StageHistogram *poseAgeStage = metricStage("pose_age");
+    static StageHistogram *predictStage = metricStage("predict_ahead");
+    static StageHistogram *rectifyStage = metricStage("rectify");
+
+    // Capture thread -> detection/pose workers -> this thread for drawing and display.
+    // Workers start from fresh tracking state every run so replays are repeatable.
+    Pipeline pipeline(session.threads);
+    pipeline.dropFrames = dropFrames;
+    // Only live input skips ahead; a replay shows every frame with its own pose
+    pipeline.keepLatest = session.predict && dropFrames && session.threads > 0;
+    if (session.multiTarget) {
+        resetPlacements(session.targets);
+    }
+    std::vector<FrameWorker> workers(std::max(session.threads, 1));
+    for (FrameWorker &worker : workers) {
+        worker.tracker = session.tracker;
+        worker.pose = session.pose;
+        if (session.multiTarget) {
+            initTargetTracker(worker.targets, session.targets, session.tracker, session.pose);
         }
     }
-
-    if (found) {
-        // Refine corner locations for better accuracy
-        cv::TermCriteria criteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 100, 0.001);
-        cv::cornerSubPix(gray, framePoints, cv::Size(11, 11), cv::Size(-1, -1), criteria);
-
-        
-        ///cv::resize(image, image, cv::Size(frame.cols, frame.rows));
-        //image.copyTo(frame);
-        std::string imageFilename = "cloth.jpg";
-        cv::Mat rot, trans;
-        //drawOnTarget(frame, frame, camera_matrix, distortion_coefficients, rot, trans, imageFilename);
-        
-        // Draw chessboard corners on the frame
-        //cv::drawChessboardCorners(frame, boardSize, framePoints, found);
-
-        // Print information about the corners
-        //std::cout << "Number of corners: " << framePoints.size() << "\n";
-        //std::cout << "Coordinates of the first corner: (" << framePoints[0].x << ", " << framePoints[0].y << ")\n";
-
-        // Estimate the pose of the target board
-        cv::Mat rvec, tvec;
-        double reprojectionError = cv::solvePnP(point_set, framePoints, camera_matrix, distortion_coefficients, rvec, tvec);
-        std::cout << "Re-projection Error: " << reprojectionError << "\n";
-        std::cout << "Rotation vector (rvec):\n" << rvec << "\n";
-        std::cout << "Translation vector (tvec):\n" << tvec << "\n";
-
-        // Call drawOnTarget function with rvec and tvec
-        drawOnTarget(frame, camera_matrix, distortion_coefficients, rvec, tvec, imageFilename);
-
-
-        std::vector<cv::Point2f> edges;
-        std::vector<cv::Point3f> axisPoints = { {0, 0, 0}, {2, 0, 0}, {0, -2, 0}, {0, 0, 2} };
-        cv::projectPoints(axisPoints, rvec, tvec, camera_matrix, distortion_coefficients, edges);
-
-        
-        // // Draw axes on the frame
-        // cv::line(frame, edges[0], edges[1], cv::Scalar(0, 0, 255), 4); // X-axis (red)
-        // cv::line(frame, edges[0], edges[2], cv::Scalar(0,255 , 0), 4); // Y-axis (green)
-        // cv::line(frame, edges[0], edges[3], cv::Scalar(255, 0, 0), 4); // Z-axis (blue)
-
-        
-        // Define vertices of the hexagonal prism and cubes attached to it
-        // Define vertices of the hexagonal prism and cubes attached to it
-        // Define vertices of the hexagonal prism
-        std::vector<cv::Point3f> hexPrismPoints = {
-            {0, 0, 0},             // Bottom face vertices of the hexagonal prism
-            {1, 0, 0},
-            {1.5, 0.866, 0},
-            {1, 1.732, 0},
-            {0, 1.732, 0},
-            {-0.5, 0.866, 0},
-            {0, 0, 1},              // Top face vertices of the hexagonal prism
-            {1, 0, 1},
-            {1.5, 0.866, 1},
-            {1, 1.732, 1},
-            {0, 1.732, 1},
-            {-0.5, 0.866, 1}
-        };
-
-        // Project 3D points of the hexagonal prism onto the image plane
-        std::vector<cv::Point2f> hexPrismCorners;
-        cv::projectPoints(hexPrismPoints, rvec, tvec, camera_matrix, distortion_coefficients, hexPrismCorners);
-
-        // Draw lines representing the edges of the hexagonal prism
-        cv::line(frame, hexPrismCorners[0], hexPrismCorners[1], cv::Scalar(0, 255, 255), 2); // Bottom face edges
-        cv::line(frame, hexPrismCorners[1], hexPrismCorners[2], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[2], hexPrismCorners[3], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[3], hexPrismCorners[4], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[4], hexPrismCorners[5], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[5], hexPrismCorners[0], cv::Scalar(0, 255, 255), 2);
-
-        cv::line(frame, hexPrismCorners[6], hexPrismCorners[7], cv::Scalar(0, 255, 255), 2); // Top face edges
-        cv::line(frame, hexPrismCorners[7], hexPrismCorners[8], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[8], hexPrismCorners[9], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[9], hexPrismCorners[10], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[10], hexPrismCorners[11], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[11], hexPrismCorners[6], cv::Scalar(0, 255, 255), 2);
-
-        cv::line(frame, hexPrismCorners[0], hexPrismCorners[6], cv::Scalar(0, 255, 255), 2); // Connecting edges
-        cv::line(frame, hexPrismCorners[1], hexPrismCorners[7], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[2], hexPrismCorners[8], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[3], hexPrismCorners[9], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[4], hexPrismCorners[10], cv::Scalar(0, 255, 255), 2);
-        cv::line(frame, hexPrismCorners[5], hexPrismCorners[11], cv::Scalar(0, 255, 255), 2);
-
-        // Define vertices of the cubes attached to the hexagonal prism
-        std::vector<cv::Point3f> cube1Points = {
-            {0, 0, 0},     // Bottom face vertices of cube 1
-            {1, 0, 0},
-            {1, 1, 0},
-            {0, 1, 0},
-            {0, 0, 1},     // Top face vertices of cube 1
-            {1, 0, 1},
-            {1, 1, 1},
-            {0, 1, 1}
-        };
-
-        std::vector<cv::Point3f> cube2Points = {
-            {0, 0, 0},     // Bottom face vertices of cube 2
-            {1, 0, 0},
-            {1, 1, 0},
-            {0, 1, 0},
-            {0, 0, 1},     // Top face vertices of cube 2
-            {1, 0, 1},
-            {1, 1, 1},
-            {0, 1, 1}
-        };
-
-        // Move cube 1 to one side of the hexagonal prism
-        for (auto &point : cube1Points) {
-            point.x += 0.75;  // Adjust the x-coordinate to attach to the side of the hexagonal prism
+    PoseFilter filter = session.filter;
+    const std::vector<cv::Vec3f> &point_set = session.point_set;
+
+    // The governor and the scene start at full quality, not where the last run left them
+    resetGovernor(session.governor);
+    session.scene = session.levelScene[0];
+
+    pipeline.capture = capture;
+    pipeline.analyze = [&](int worker, FramePacket &packet) {
+        analyzeFrame(workers[worker], session, packet);
+    };
+
+    // Pose log next to the overlay frames
+    FILE *poseLog = nullptr;
+    if (!session.outputDir.empty()) {
+        cv::utils::fs::createDirectories(session.outputDir);
+        std::string logFilename = cv::utils::fs::join(session.outputDir, "poses.csv");
+        poseLog = fopen(logFilename.c_str(), "w");
+        if (!poseLog) {
+            std::cerr << "Error: Could not write " << logFilename << std::endl;
+        } else {
+            fprintf(poseLog, "frame,time,found,source,rms,rx,ry,rz,tx,ty,tz\n");
         }
+    }
 
-        // Move cube 2 to the opposite side of the hexagonal prism
-        for (auto &point : cube2Points) {
-            point.x -= 0.75;  // Adjust the x-coordinate to attach to the opposite side of the hexagonal prism
+    double startTime = pipelineClock();
+    startPipeline(pipeline);
+    countAllocations();
+
+    FramePacket packet;
+    cv::Mat lateFrame, lateSpare;   // newest captured frame and its undistortion buffer
+    cv::Mat rvec, tvec;             // pose the overlay is drawn with
+    int64_t lastShownSeq = -1;      // frame last put on screen
+    uint64_t warmOwn = 0, warmLibrary = 0;
+    while (nextPacket(pipeline, packet)) {
+        double renderStart = pipelineClock();
+        if (pipeline.framesShown == allocationWarmupFrames) {
+            warmOwn = ownAllocations();
+            warmLibrary = libraryAllocations();
         }
 
-        // Project 3D points of the cubes onto the image plane
-        std::vector<cv::Point2f> cube1Corners, cube2Corners;
-        cv::projectPoints(cube1Points, rvec, tvec, camera_matrix, distortion_coefficients, cube1Corners);
-        cv::projectPoints(cube2Points, rvec, tvec, camera_matrix, distortion_coefficients, cube2Corners);
-
-        // Draw lines representing the edges of cube 1
-        cv::line(frame, cube1Corners[0], cube1Corners[1], cv::Scalar(255, 0, 255), 2); // Bottom face edges
-        cv::line(frame, cube1Corners[1], cube1Corners[2], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube1Corners[2], cube1Corners[3], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube1Corners[3], cube1Corners[0], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube1Corners[4], cube1Corners[5], cv::Scalar(255, 0, 255), 2); // Top face edges
-        cv::line(frame, cube1Corners[5], cube1Corners[6], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube1Corners[6], cube1Corners[7], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube1Corners[7], cube1Corners[4], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube1Corners[0], cube1Corners[4], cv::Scalar(255, 0, 255), 2); // Connecting edges
-        cv::line(frame, cube1Corners[1], cube1Corners[5], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube1Corners[2], cube1Corners[6], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube1Corners[3], cube1Corners[7], cv::Scalar(255, 0, 255), 2);
-
-        // Draw lines representing the edges of cube 2
-        cv::line(frame, cube2Corners[0], cube2Corners[1], cv::Scalar(255, 0, 255), 2); // Bottom face edges
-        cv::line(frame, cube2Corners[1], cube2Corners[2], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube2Corners[2], cube2Corners[3], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube2Corners[3], cube2Corners[0], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube2Corners[4], cube2Corners[5], cv::Scalar(255, 0, 255), 2); // Top face edges
-        cv::line(frame, cube2Corners[5], cube2Corners[6], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube2Corners[6], cube2Corners[7], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube2Corners[7], cube2Corners[4], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube2Corners[0], cube2Corners[4], cv::Scalar(255, 0, 255), 2); // Connecting edges
-        cv::line(frame, cube2Corners[1], cube2Corners[5], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube2Corners[2], cube2Corners[6], cv::Scalar(255, 0, 255), 2);
-        cv::line(frame, cube2Corners[3], cube2Corners[7], cv::Scalar(255, 0, 255), 2);
-
-
-
-       // Define vertices of the multiplanar 3D object (football) with tilt and shift
-        std::vector<cv::Point3f> footballPoints;
-
-        // Define points for the upper hemisphere with tilt and shift
-        for (float theta = 0; theta <= CV_PI / 2; theta += CV_PI / 10) {
-            for (float phi = 0; phi < 2 * CV_PI; phi += CV_PI / 10) {
-                float tilt = 0.1; // Tilt factor towards the center and specified point
-                float shift_x = 5; // Shift the football more to the right
-                float shift_z = 3; // Shift the football higher in the air
-                float x = cos(phi) * cos(theta) - tilt * cos(theta) + tilt * 4 + shift_x;
-                float y = sin(phi) * cos(theta) - tilt * cos(theta) - tilt * 4;
-                float z = sin(theta) + tilt * 4 + shift_z;
-                footballPoints.push_back(cv::Point3f(x, y, z));
+        // Detection and pose lag capture by a frame or more. Rather than show the frame the
+        // pose came from, draw onto the newest frame, with the pose carried forward to its capture time.
+        double shownTime = packet.captureTime;
+        uint64_t shownSeq = packet.seq;
+        uint64_t afterSeq = (uint64_t)std::max((int64_t)packet.seq, lastShownSeq);
+        bool late = takeLatestFrame(pipeline, afterSeq, lateFrame, shownTime, shownSeq);
+        if (!late && (int64_t)packet.seq <= lastShownSeq) {
+            // A later frame is already on screen and nothing newer has been captured: the
+            // result only moves the pose filter on, the next frame shows it
+            if (packet.found) {
+                filterPose(filter, packet.captureTime, packet.rvec, packet.tvec);
+            } else {
+                resetPoseFilter(filter);
             }
+            skipPacket(pipeline, packet);
+            continue;
         }
-
-        // Define points for the lower hemisphere with tilt and shift
-        for (float theta = CV_PI / 2; theta <= CV_PI; theta += CV_PI / 10) {
-            for (float phi = 0; phi < 2 * CV_PI; phi += CV_PI / 10) {
-                float tilt = 0.1; // Tilt factor towards the center and specified point
-                float shift_x = 5; // Shift the football more to the right
-                float shift_z = 3; // Shift the football higher in the air
-                float x = cos(phi) * cos(theta) - tilt * cos(theta) + tilt * 4 + shift_x;
-                float y = sin(phi) * cos(theta) - tilt * cos(theta) - tilt * 4;
-                float z = sin(theta) + tilt * 4 + shift_z;
-                footballPoints.push_back(cv::Point3f(x, y, z));
+        lastShownSeq = (int64_t)shownSeq;
+        if (late && session.undistort) {
+            ScopedTimer timer(rectifyStage);
+            RectifyMapsPtr maps = rectifyMaps(session.rectify, packet.intrinsics, lateFrame.size());
+            if (!maps->map1.empty()) {
+                {
+                    OutputScope output(lateSpare);
+                    rectifyFrame(*maps, lateFrame, lateSpare);
+                }
+                std::swap(lateFrame, lateSpare);
+            }
+        }
+        cv::Mat &frame = late ? lateFrame : packet.frame;
+        const cv::Mat &frame_camera_matrix = packet.drawIntrinsics->camera_matrix;
+        const std::vector<double> &frame_distortion = packet.drawIntrinsics->distortion_coefficients;
+
+        // Report how long detection took and which search found the board
+        char detectText[96];
+        if (session.multiTarget) {
+            snprintf(detectText, sizeof(detectText), "detect %.1f ms (targets %d seen, %d fused of %d)", packet.detectMs,
+                     packet.targetsFound, packet.targetsFused, (int)session.targets.targets.size());
+        } else if (session.governor.targetFps > 0) {
+            snprintf(detectText, sizeof(detectText), "detect %.1f ms (%s) quality %s%s", packet.detectMs, detectSourceName(packet.source),
+                     qualityLevel(session.governor.level).name, session.governor.absent ? ", idle search" : "");
+        } else {
+            snprintf(detectText, sizeof(detectText), "detect %.1f ms (%s)", packet.detectMs, detectSourceName(packet.source));
+        }
+        {
+            LibraryScope library;
+            cv::putText(frame, detectText, cv::Point(10, 25), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 255, 0), 2);
+            if (session.calibrator && session.calibrator->busy) {
+                cv::putText(frame, "calibrating...", cv::Point(10, 50), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 255, 255), 2);
             }
         }
 
-        // Project 3D points of the football onto the image plane
-        std::vector<cv::Point2f> footballCorners;
-        cv::projectPoints(footballPoints, rvec, tvec, camera_matrix, distortion_coefficients, footballCorners);
+        if (packet.found) {
+            // Smooth the pose in frame order before anything is drawn with it
+            filterPose(filter, packet.captureTime, packet.rvec, packet.tvec);
+            packet.rvec.copyTo(rvec);
+            packet.tvec.copyTo(tvec);
+            if (late) {
+                recordDuration(predictStage, predictPose(filter, shownTime, rvec, tvec) * 1000.0);
+            }
 
-        // Draw lines representing the edges of the football
-        for (size_t i = 0; i < footballCorners.size(); ++i) {
-            for (size_t j = i + 1; j < footballCorners.size(); ++j) {
-                cv::line(frame, footballCorners[i], footballCorners[j], cv::Scalar(0, 255, 255), 1);
+            // Lay the texture onto the board first, the virtual objects stand on it
+            if (!session.texture.levels.empty()) {
+                ScopedTimer timer(textureStage);
+                drawBoardTexture(session.texture, frame, rvec, tvec, frame_camera_matrix, frame_distortion);
             }
-        }
 
+            // Draw chessboard corners on the frame
+            //cv::drawChessboardCorners(frame, boardSize, packet.corners, packet.found);
+
+            // The pose is only formatted when the logger will print it
+            if (logReady(LOG_POSE)) {
+                const double *r = packet.rvec.ptr<double>();
+                const double *t = packet.tvec.ptr<double>();
+                char text[logLineSize];
+                snprintf(text, sizeof(text),
+                         "Re-projection Error: %g px RMS%s\nRotation vector (rvec):\n[%g;\n %g;\n %g]\nTranslation vector (tvec):\n[%g;\n %g;\n %g]\n",
+                         packet.reprojectionError, packet.fullSolve ? " (full solve)" : "", r[0], r[1], r[2], t[0], t[1], t[2]);
+                logLine(text);
+            }
 
+            // Draw the model at the board pose
+            if (session.filledMesh) {
+                ScopedTimer timer(rasterStage);
+                renderMesh(session.renderer, frame, session.mesh, rvec, tvec, frame_camera_matrix, frame_distortion);
+            } else {
+                ScopedTimer timer(drawStage);
+                drawOnTarget(frame, frame_camera_matrix, frame_distortion, rvec, tvec, session.mesh, session.meshScratch);
+            }
 
+            // Project the whole scene once and draw its edge list
+            {
+                ScopedTimer timer(projectStage);
+                projectScene(session.scenes[session.scene], rvec, tvec, frame_camera_matrix, frame_distortion);
+            }
+            {
+                ScopedTimer timer(drawStage);
+                LibraryScope library;
+                drawScene(frame, session.scenes[session.scene]);
+            }
+        } else {
+            resetPoseFilter(filter);
+            if (logReady(LOG_DETECT)) {
+                logLine("Chessboard not found in the image.\n");
+            }
+        }
 
+        // Show the frame before anything is written to disk
+        char key = 0;
+        if (!session.headless) {
+            ScopedTimer timer(displayStage);
+            LibraryScope library;
+            imshow("Video", frame);
 
+            // One short wait per frame serves both keys
+            key = cv::waitKey(1);
+        }
 
-        
+        // Capture to display of the frame shown, and how old the pose it was drawn with is
+        double shownAt = pipelineClock();
+        recordDuration(frameStage, (shownAt - shownTime) * 1000.0);
+        recordDuration(poseAgeStage, (shownAt - packet.captureTime) * 1000.0);
+        recordFrame();
+
+        if (!session.outputDir.empty()) {
+            ScopedTimer timer(outputStage);
+            char name[1024];
+            snprintf(name, sizeof(name), "%s/frame_%06llu.png", session.outputDir.c_str(), (unsigned long long)shownSeq);
+            {
+                LibraryScope library;
+                cv::imwrite(name, frame);
+            }
+            // The frame written and the pose it was drawn with, predicted when the frame is a later one
+            if (poseLog) {
+                double r[3] = {0, 0, 0}, t[3] = {0, 0, 0};
+                if (packet.found) {
+                    for (int i = 0; i < 3; ++i) {
+                        r[i] = rvec.at<double>(i);
+                        t[i] = tvec.at<double>(i);
+                    }
+                }
+                fprintf(poseLog, "%llu,%.6f,%d,%s,%.4f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", (unsigned long long)shownSeq,
+                        shownTime - startTime, packet.found ? 1 : 0, detectSourceName(packet.source),
+                        packet.reprojectionError, r[0], r[1], r[2], t[0], t[1], t[2]);
+            }
+        }
 
-        cv::Mat old_camera_matrix = camera_matrix.clone(); // Store the old camera matrix
-        // Save corner locations and 3D world points when 's' is pressed
-        char key = cv::waitKey(10);
-        if (key == 's') {
-            corner_list.push_back(framePoints);
-            point_list.push_back(point_set);
+        // Let the governor see this frame's cost; a new level may draw a coarser scene
+        double renderEnd = pipelineClock();
+        if (governFrame(session.governor, renderEnd, packet.found, (renderEnd - renderStart) * 1000.0,
+                        packet.detectMs + packet.poseMs, session.threads)) {
+            session.scene = session.levelScene[session.governor.level];
+        }
+
+        if (key == 'q') {
+            break;  // Break the loop if 'q' key is pressed
+        }
 
+        // Save corner locations and 3D world points when 's' is pressed
+        if (key == 's' && packet.found && session.calibrator && !session.multiTarget) {
             // Print saved coordinates
             std::cout << "Corner Set:\n";
-            for (size_t i = 0; i < corner_list.back().size(); ++i) {
-                std::cout << "(" << corner_list.back()[i].x << ", " << corner_list.back()[i].y << ") ";
+            for (size_t i = 0; i < packet.corners.size(); ++i) {
+                std::cout << "(" << packet.corners[i].x << ", " << packet.corners[i].y << ") ";
             }
             std::cout << "\n";
 
             std::cout << "Point Set:\n";
-            for (size_t i = 0; i < point_list.back().size(); ++i) {
-                std::cout << "(" << point_list.back()[i][0] << ", " << point_list.back()[i][1] << ", " << point_list.back()[i][2] << ") ";
+            for (size_t i = 0; i < point_set.size(); ++i) {
+                std::cout << "(" << point_set[i][0] << ", " << point_set[i][1] << ", " << point_set[i][2] << ") ";
             }
             std::cout << "\n";
 
-            // Perform camera calibration
-            double error = cv::calibrateCamera(point_list, corner_list, frame.size(), camera_matrix, distortion_coefficients, rotations, translations);
+            // Calibrate on the background worker, the video keeps running while it solves
+            addCalibrationView(*session.calibrator, packet.corners, point_set);
+        }
 
-            // Print camera matrix, distortion coefficients, and re-projection error
-            std::cout << "Old Camera Matrix:\n" << old_camera_matrix << "\n";
-            std::cout << "Camera Matrix:\n" << camera_matrix << "\n";
+        // Hand the packet back so its buffers carry the next frame
+        recyclePacket(pipeline, packet);
+    }
+    if (pipeline.framesShown > allocationWarmupFrames) {
+        stats.steadyFrames = pipeline.framesShown - allocationWarmupFrames;
+        stats.ownAllocations = ownAllocations() - warmOwn;
+        stats.libraryAllocations = libraryAllocations() - warmLibrary;
+    }
+    stopPipeline(pipeline);
+    stats.seconds = pipelineClock() - startTime;
+    if (poseLog) {
+        fclose(poseLog);
+    }
 
-            std::cout << "Distortion Coefficients:\n";
-            for (size_t i = 0; i < distortion_coefficients.size(); ++i) {
-                std::cout << distortion_coefficients[i] << " ";
-            }
-            std::cout << "\n";
-            std::cout << "Re-projection Error: " << error << "\n" <<"\n";
+    stats.framesShown = pipeline.framesShown;
+    stats.framesDropped = pipeline.droppedCaptured + pipeline.droppedAnalyzed + pipeline.framesLate;
+    printf("Frames captured: %llu, shown: %llu, dropped: %llu\n", (unsigned long long)pipeline.framesCaptured,
+           (unsigned long long)stats.framesShown, (unsigned long long)stats.framesDropped);
 
+    double detectMs = 0;
+    int detectFrames = 0;
+    for (const FrameWorker &worker : workers) {
+        detectMs += worker.tracker.totalMs;
+        detectFrames += worker.tracker.frames;
+    }
+    if (detectFrames > 0) {
+        printf("Average detection time: %.2f ms over %d frames\n", detectMs / detectFrames, detectFrames);
+    }
 
-            std::cout << "rotations:\n";
-            for (size_t i = 0; i < rotations.size(); ++i) {
-                std::cout << "Rotation matrix " << i << ":\n" << rotations[i] << "\n";
-            }
+    int fullSolves = 0, trackedSolves = 0;
+    for (const FrameWorker &worker : workers) {
+        fullSolves += worker.pose.fullSolves;
+        trackedSolves += worker.pose.trackedSolves;
+    }
+    printf("Poses: %d tracked, %d full solves\n", trackedSolves, fullSolves);
+    if (session.governor.targetFps > 0) {
+        printf("Governor: %d changes, ending at quality %s\n", session.governor.changes, qualityLevel(session.governor.level).name);
+    }
+    if (session.undistort) {
+        printf("Undistortion tables built: %d\n", (int)session.rectify.rebuilds);
+    }
+    if (session.checkAllocations) {
+        printf("Allocations over %llu frames after a %llu frame warm-up: %llu own, %llu inside OpenCV (%.1f per frame)\n",
+               (unsigned long long)stats.steadyFrames, (unsigned long long)allocationWarmupFrames,
+               (unsigned long long)stats.ownAllocations, (unsigned long long)stats.libraryAllocations,
+               stats.steadyFrames ? (double)stats.libraryAllocations / stats.steadyFrames : 0.0);
+    }
+}
 
-            std::cout << "translations:\n";
-            for (size_t i = 0; i < translations.size(); ++i) {
-                std::cout << "Translation matrix " << i << ":\n" << translations[i] << "\n";
+
+// Replay a recorded dataset from memory: a warm-up pass, then timed repetitions written
+// as one JSON report so runs on different builds and machines can be compared
+static int runBenchmark(ArSession &session, FrameSource &source, int maxFrames, int warmupFrames, int repetitions,
+                        const std::string &reportFilename) {
+    std::vector<cv::Mat> frames;
+    if (!loadFrames(source, frames, maxFrames)) {
+        std::cerr << "Error: No frames in " << source.spec << std::endl;
+        return -1;
+    }
+    printf("Benchmark: %d frames, %d warm-up, %d repetitions\n", (int)frames.size(), warmupFrames, repetitions);
+
+    size_t frameLimit = frames.size();
+    size_t next = 0;
+    CaptureStage replay = [&](cv::Mat &frame) {
+        static StageHistogram *captureStage = metricStage("capture");
+        ScopedTimer timer(captureStage);
+        countAllocations();
+        if (next >= frameLimit) {
+            return false;
+        }
+        frames[next++].copyTo(frame);
+        return true;
+    };
+
+    // Warm caches, allocators and the thread pool before anything is measured
+    RunStats stats;
+    if (warmupFrames > 0) {
+        frameLimit = std::min(frames.size(), (size_t)warmupFrames);
+        next = 0;
+        runSession(session, replay, false, stats);
+    }
+
+    std::ostringstream runs;
+    std::vector<double> fps;
+    frameLimit = frames.size();
+    for (int r = 0; r < repetitions; ++r) {
+        resetMetrics();
+        next = 0;
+        runSession(session, replay, false, stats);
+        fps.push_back(stats.seconds > 0 ? stats.framesShown / stats.seconds : 0.0);
+        runs << (r ? "," : "") << metricsJson();
+    }
+    std::sort(fps.begin(), fps.end());
+
+    FILE *report = reportFilename == "-" ? stdout : fopen(reportFilename.c_str(), "w");
+    if (!report) {
+        std::cerr << "Error: Could not write " << reportFilename << std::endl;
+        return -1;
+    }
+    fprintf(report, "{\"dataset\":\"%s\",\"frames\":%d,\"threads\":%d,\"detect\":\"%s\",\"undistort\":%s,\"warmup_frames\":%d,\"repetitions\":%d,"
+            "\"fps_min\":%.4f,\"fps_median\":%.4f,\"fps_max\":%.4f,\"runs\":[%s]}\n",
+            source.spec.c_str(), (int)frames.size(), session.threads, detectModeName(session.tracker.mode),
+            session.undistort ? "true" : "false", warmupFrames,
+            repetitions, fps.empty() ? 0.0 : fps.front(), fps.empty() ? 0.0 : fps[fps.size() / 2],
+            fps.empty() ? 0.0 : fps.back(), runs.str().c_str());
+    if (report != stdout) {
+        fclose(report);
+        printf("Benchmark report written to %s\n", reportFilename.c_str());
+    }
+    return 0;
+}
+
+
+
+int main(int argc, char *argv[]) {
+    // Command line options
+    ArSession session;
+    int lod = 20;  // Segments around curved objects, lower it on slow devices
+    int maxViews = 0;  // Calibrate over at most this many pose-diverse views, 0 uses every view
+    std::string input = "0";  // Camera index, video file, image directory or glob
+    int maxFrames = 0;  // Stop after this many frames, 0 runs to the end of the input
+    std::string benchReport;  // Benchmark the input and write the JSON report here ("-" for stdout)
+    int warmupFrames = 30;  // Frames run before a benchmark is measured
+    int repetitions = 5;  // Measured benchmark passes over the input
+    std::string calibrationDir = "calibration";  // Saved calibrations, one file per camera and resolution
+    std::string cameraId;  // Key of the saved calibration, derived from --input when empty
+    std::string calibrationFile;  // Load and save this calibration file instead
+    bool freshCalibration = false;  // Ignore the saved calibration and start uncalibrated
+    std::string metricsTarget;  // JSON-lines metrics destination: a file path or udp://host:port
+    double metricsInterval = 1.0;  // Seconds per exported metrics line
+    double logInterval = 1.0;  // Seconds between pose/status lines on the console
+    std::string textureFilename = "brick.jpeg";  // Image laid onto the board, "none" for no texture
+    std::string targetsFile;  // Chessboards and marker boards tracked together, see target_set.h
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--lod") == 0 && i + 1 < argc) {
+            lod = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            session.threads = std::max(0, atoi(argv[++i]));  // Detection/pose worker threads, 0 runs every stage on the main thread
+        } else if (strcmp(argv[i], "--max-views") == 0 && i + 1 < argc) {
+            maxViews = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pose") == 0 && i + 1 < argc) {
+            // Pose from the last frame's pose: refine (LM only) or guess (solvePnP with a guess)
+            session.pose.refineOnly = strcmp(argv[++i], "guess") != 0;
+        } else if (strcmp(argv[i], "--predict") == 0 && i + 1 < argc) {
+            session.predict = strcmp(argv[++i], "off") != 0;  // on: overlay on the newest frame with a predicted pose
+        } else if (strcmp(argv[i], "--target-fps") == 0 && i + 1 < argc) {
+            session.governor.targetFps = atof(argv[++i]);  // Frame rate the governor holds by lowering quality, 0 for off
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            if (!parsePoseFilter(argv[++i], session.filter)) {
+                printf("Unknown pose filter: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--calib-dir") == 0 && i + 1 < argc) {
+            calibrationDir = argv[++i];
+        } else if (strcmp(argv[i], "--camera-id") == 0 && i + 1 < argc) {
+            cameraId = argv[++i];
+        } else if (strcmp(argv[i], "--calibration") == 0 && i + 1 < argc) {
+            calibrationFile = argv[++i];
+        } else if (strcmp(argv[i], "--fresh-calibration") == 0) {
+            freshCalibration = true;
+        } else if (strcmp(argv[i], "--undistort") == 0) {
+            session.undistort = true;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            session.headless = true;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            session.outputDir = argv[++i];
+        } else if (strcmp(argv[i], "--max-frames") == 0 && i + 1 < argc) {
+            maxFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            benchReport = argv[++i];
+            session.headless = true;
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmupFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repetitions = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metricsTarget = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+            metricsInterval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--log-interval") == 0 && i + 1 < argc) {
+            logInterval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--detect") == 0 && i + 1 < argc) {
+            // Board search mode: full, roi, pyramid or flow
+            if (!parseDetectMode(argv[++i], session.tracker.mode)) {
+                printf("Unknown detection mode: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--texture") == 0 && i + 1 < argc) {
+            textureFilename = argv[++i];
+        } else if (strcmp(argv[i], "--targets") == 0 && i + 1 < argc) {
+            targetsFile = argv[++i];
+        } else if (strcmp(argv[i], "--render") == 0 && i + 1 < argc) {
+            // The model as filled faces (filled) or face outlines (wire)
+            ++i;
+            if (strcmp(argv[i], "filled") == 0 || strcmp(argv[i], "wire") == 0) {
+                session.filledMesh = strcmp(argv[i], "filled") == 0;
+            } else {
+                printf("Unknown render mode: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--shading") == 0 && i + 1 < argc) {
+            if (!parseShadeMode(argv[++i], session.renderer.shading)) {
+                printf("Unknown shading: %s\n", argv[i]);
+                return -1;
             }
+        } else if (strcmp(argv[i], "--check-allocations") == 0) {
+            // Fail if the frame loop still allocates once it is warmed up
+            session.checkAllocations = true;
+        }
+    }
+    if (session.checkAllocations && !installAllocationCounter()) {
+        std::cerr << "Error: --check-allocations needs a build with -DCOUNT_ALLOCATIONS" << std::endl;
+        return -1;
+    }
+
+    // Open the video device, or the recorded video / image sequence
+    FrameSource source;
+    if (!openFrameSource(input, source)) {
+        printf("Unable to open video source %s\n", input.c_str());
+        return -1;
+    }
+
+    // Get some properties of the image
+    cv::Size refS = frameSourceSize(source);
+    printf("Expected size: %d %d\n", refS.width, refS.height);
 
-           
-           
+    if (!session.headless) {
+        cv::namedWindow("Video", 1); // Identifies a window
+    }
+    std::string obj_filename = "cup.obj";
 
-            // Save intrinsic parameters to a file
-            cv::FileStorage fs("intrinsic_params.yaml", cv::FileStorage::WRITE);
-            fs << "camera_matrix" << camera_matrix;
-            fs << "Rotaion matrices" << rotations;
+    // Parse the model once, every frame draws from the cached mesh
+    session.mesh = loadMesh(obj_filename);
+    if (!session.mesh) {
+        std::cerr << "Error: Could not read mesh file " << obj_filename << std::endl;
+    }
 
-            fs << "Translation matrices" << translations;
+    // Build the virtual objects once, every frame only projects and draws them
+    session.lod = lod;
+    buildScenes(session);
 
-            fs << "distortion_coefficients" << distortion_coefficients;
-            fs.release();
+    // Define the chessboard size (rows x columns)
+    cv::Size boardSize = DemoBoard::size();
+    session.tracker.boardSize = boardSize;
+
+    // Texture for the board plane, loaded once with its mip levels
+    if (textureFilename != "none") {
+        if (loadBoardTexture(textureFilename, session.texture)) {
+            session.texture.area = boardArea(boardSize);
+        } else {
+            std::cerr << "Could not read texture " << textureFilename << ", the board is drawn without it" << std::endl;
         }
+    }
 
-    } else {
-        std::cout << "Chessboard not found in the image.\n";
+    // 3D world coordinates of the corners, each square 1 unit; the grid itself is built at compile time
+    session.point_set = DemoBoard::objectPoints();
+
+    // Several targets instead of the one board: the world frame is the first target's, and the
+    // texture only covers it when it is a chessboard
+    if (!targetsFile.empty()) {
+        if (!loadTargetSet(targetsFile, session.targets)) {
+            std::cerr << "Error: Could not read targets from " << targetsFile << std::endl;
+            return -1;
+        }
+        session.multiTarget = true;
+        const Target &origin = session.targets.targets[0];
+        if (origin.kind == TARGET_CHESSBOARD) {
+            float square = origin.points[1][0] - origin.points[0][0];
+            cv::Rect2f area = boardArea(origin.boardSize);
+            session.texture.area = cv::Rect2f(area.x * square, area.y * square, area.width * square, area.height * square);
+        } else {
+            session.texture.levels.clear();
+        }
+        printf("Tracking %d targets\n", (int)session.targets.targets.size());
     }
 
-        imshow("Video", frame);
+    cv::Mat camera_matrix = cv::Mat::eye(3, 3, CV_64F); // Initialize camera matrix
+    camera_matrix.at<double>(0, 2) = refS.width / 2; // Initialize center of the image
+    camera_matrix.at<double>(1, 2) = refS.height / 2;
 
-        char key = cv::waitKey(10);
-        if (key == 'q') {
-            break;  // Break the loop if 'q' key is pressed
+    std::vector<double> distortion_coefficients; // Define distortion coefficients
+
+    // Start from this camera's saved calibration when there is one for this resolution
+    if (cameraId.empty()) {
+        cameraId = cameraIdFor(input);
+    }
+    std::string storeFile = calibrationFile.empty() ? calibrationPath(calibrationDir, cameraId, refS) : calibrationFile;
+    StoredCalibration stored;
+    bool restored = !freshCalibration && loadCalibration(storeFile, refS, stored);
+    if (restored) {
+        camera_matrix = stored.camera_matrix;
+        distortion_coefficients = stored.distortion_coefficients;
+        printf("Loaded calibration %s: %d views, %.3f px RMS\n", storeFile.c_str(), (int)stored.views.size(), stored.error);
+    }
+
+    // Workers read the calibration through this snapshot, the calibration worker publishes new ones
+    session.shared_intrinsics = makeIntrinsics(camera_matrix, distortion_coefficients);
+
+    // Per-frame console output goes through the rate-limited logger, stage timings to the exporter
+    startLogger(logInterval);
+    if (!metricsTarget.empty() && !startMetricsExport(metricsTarget, metricsInterval)) {
+        return -1;
+    }
+
+    int status = 0;
+    if (!benchReport.empty()) {
+        status = runBenchmark(session, source, maxFrames, warmupFrames, repetitions, benchReport);
+    } else {
+        // Views saved with 's' are solved on a background thread
+        CalibrationWorker calibrator;
+        calibrator.maxViews = maxViews;
+        calibrator.storeFile = storeFile;
+        calibrator.cameraId = cameraId;
+        if (restored) {
+            restoreCalibrationViews(calibrator, stored.views);
+        }
+        if (!session.headless) {
+            startCalibrationWorker(calibrator, session.shared_intrinsics, refS);
+            session.calibrator = &calibrator;
+        }
+
+        int framesRead = 0;
+        CaptureStage capture = [&](cv::Mat &frame) {
+            static StageHistogram *captureStage = metricStage("capture");
+            ScopedTimer timer(captureStage);
+            countAllocations();
+            if (maxFrames > 0 && framesRead >= maxFrames) {
+                return false;
+            }
+            OutputScope output(frame);
+            if (!readFrame(source, frame)) { // Get a new frame, treat as a stream
+                if (source.live) {
+                    printf("Frame is empty\n");
+                }
+                return false;
+            }
+            framesRead++;
+            return true;
+        };
+
+        // A camera drops frames to stay live, a recording is processed frame by frame
+        RunStats stats;
+        runSession(session, capture, source.live, stats);
+        if (session.checkAllocations) {
+            if (stats.steadyFrames == 0) {
+                std::cerr << "Error: Too few frames to check allocations after the warm-up" << std::endl;
+                status = -1;
+            } else if (stats.ownAllocations > 0) {
+                std::cerr << "Error: The frame loop allocated " << stats.ownAllocations << " times after the warm-up" << std::endl;
+                status = 1;
+            }
+        }
+
+        if (session.calibrator) {
+            stopCalibrationWorker(calibrator);
         }
     }
-    
-    // Clean up resources
-    delete capdev;
-    return 0;
+    stopMetricsExport();
+    stopLogger();
+
+    printMetricsSummary();
+    return status;
 }
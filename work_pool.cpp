@@ -0,0 +1,167 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: parallel loop over independent tasks with work stealing
+
+#include "work_pool.h"
+
+#include <algorithm>
+
+int defaultThreadCount() {
+    return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+
+static bool takeTask(TaskRange &range, int &task) {
+    std::lock_guard<std::mutex> lock(range.mutex);
+    if (range.begin >= range.end) {
+        return false;
+    }
+    task = range.begin++;
+    return true;
+}
+
+
+// Move the back half of the fullest other range into ours
+static bool stealTasks(std::vector<std::unique_ptr<TaskRange>> &ranges, int self) {
+    int victim = -1, most = 0;
+    for (int i = 0; i < (int)ranges.size(); ++i) {
+        if (i == self) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(ranges[i]->mutex);
+        if (ranges[i]->end - ranges[i]->begin > most) {
+            most = ranges[i]->end - ranges[i]->begin;
+            victim = i;
+        }
+    }
+    if (victim < 0) {
+        return false;
+    }
+
+    int begin, end;
+    {
+        std::lock_guard<std::mutex> lock(ranges[victim]->mutex);
+        int remaining = ranges[victim]->end - ranges[victim]->begin;
+        if (remaining <= 0) {
+            return true;   // emptied meanwhile, look again
+        }
+        end = ranges[victim]->end;
+        begin = end - (remaining + 1) / 2;
+        ranges[victim]->end = begin;
+    }
+    std::lock_guard<std::mutex> lock(ranges[self]->mutex);
+    ranges[self]->begin = begin;
+    ranges[self]->end = end;
+    return true;
+}
+
+
+// Thread self's share of the current loop, then whatever it can steal
+static void runTasks(WorkPool &pool, int self) {
+    int task;
+    for (;;) {
+        while (takeTask(*pool.ranges[self], task)) {
+            pool.call(pool.context, task, self);
+        }
+        if (!stealTasks(pool.ranges, self)) {
+            return;
+        }
+    }
+}
+
+
+static void poolLoop(WorkPool &pool, int self) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.wake.wait(lock, [&] { return pool.stopping || pool.generation != seen; });
+            if (pool.stopping) {
+                return;
+            }
+            seen = pool.generation;
+        }
+        runTasks(pool, self);
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (--pool.busy == 0) {
+            pool.done.notify_one();
+        }
+    }
+}
+
+
+void startWorkPool(WorkPool &pool, int threads) {
+    if (pool.threads > 0) {
+        return;
+    }
+    pool.threads = threads > 0 ? threads : defaultThreadCount();
+    pool.stopping = false;
+    for (int i = 0; i < pool.threads; ++i) {
+        pool.ranges.emplace_back(new TaskRange);
+    }
+    for (int i = 1; i < pool.threads; ++i) {
+        pool.pool.emplace_back(poolLoop, std::ref(pool), i);
+    }
+}
+
+
+void stopWorkPool(WorkPool &pool) {
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.stopping = true;
+    }
+    pool.wake.notify_all();
+    for (std::thread &thread : pool.pool) {
+        thread.join();
+    }
+    pool.pool.clear();
+    pool.ranges.clear();
+    pool.threads = 0;
+}
+
+
+WorkPool::~WorkPool() {
+    stopWorkPool(*this);
+}
+
+
+void runWorkPool(WorkPool &pool, int count, void (*call)(void *context, int task, int thread), void *context) {
+    if (count <= 0) {
+        return;
+    }
+    startWorkPool(pool, pool.threads);
+    int threads = pool.threads;
+    int active = std::min(threads, count);
+    for (int i = 0; i < threads; ++i) {
+        // Threads past the task count start empty and only steal
+        pool.ranges[i]->begin = i < active ? (int)((long long)count * i / active) : 0;
+        pool.ranges[i]->end = i < active ? (int)((long long)count * (i + 1) / active) : 0;
+    }
+    if (threads == 1) {
+        for (int task = 0; task < count; ++task) {
+            call(context, task, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.call = call;
+        pool.context = context;
+        pool.busy = threads - 1;
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+    runTasks(pool, 0);
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.done.wait(lock, [&] { return pool.busy == 0; });
+}
+
+
+void parallelForStealing(int count, int threads, const std::function<void(int task, int thread)> &run) {
+    if (count <= 0) {
+        return;
+    }
+    WorkPool pool;
+    startWorkPool(pool, std::min(threads > 0 ? threads : defaultThreadCount(), count));
+    parallelForStealing(pool, count, run);
+}
@@ -0,0 +1,71 @@
+// Author: Hrigved Suryawanshi & Haard shah (1/19/24)
+// CODE: parallel loop over independent tasks with work stealing
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Tasks [begin, end) still owed by one thread. The owner takes from the front,
+// thieves cut off the back half.
+struct TaskRange {
+    std::mutex mutex;
+    int begin = 0;
+    int end = 0;
+};
+
+// Threads that stay up between loops, for loops that run every frame. The thread calling
+// parallelForStealing works as thread 0 next to threads - 1 pool threads, so a pool of one
+// thread runs its loops inline. Starting the pool is the only time it allocates; one loop
+// runs at a time.
+struct WorkPool {
+    WorkPool() = default;
+    WorkPool(const WorkPool &) = delete;
+    WorkPool &operator=(const WorkPool &) = delete;
+    ~WorkPool();
+
+    int threads = 0;
+    std::vector<std::thread> pool;
+    std::vector<std::unique_ptr<TaskRange>> ranges;   // one per thread
+
+    // The loop being run, handed to the pool threads under the mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    int busy = 0;
+    bool stopping = false;
+    void (*call)(void *context, int task, int thread) = nullptr;
+    void *context = nullptr;
+};
+
+// Start threads - 1 pool threads (threads 0 uses every core); does nothing if already started
+void startWorkPool(WorkPool &pool, int threads);
+void stopWorkPool(WorkPool &pool);
+
+// Run tasks 0..count-1 on the pool's threads and return when all are done.
+// Each thread starts with an even, contiguous share of the tasks and, once that is done,
+// steals half of the largest remaining share, so a few slow tasks (large or hard images)
+// do not leave the other cores idle. run receives the task and the index of its thread.
+void runWorkPool(WorkPool &pool, int count, void (*call)(void *context, int task, int thread), void *context);
+
+template <class Run>
+void parallelForStealing(WorkPool &pool, int count, Run &&run) {
+    typedef typename std::remove_reference<Run>::type Function;
+    runWorkPool(pool, count, [](void *context, int task, int thread) { (*static_cast<Function *>(context))(task, thread); },
+                (void *)&run);
+}
+
+// The same on `threads` threads (0 uses every core) started for this call only, for one-off batches
+void parallelForStealing(int count, int threads, const std::function<void(int task, int thread)> &run);
+
+int defaultThreadCount();
+
+#endif